@@ -1,77 +1,631 @@
 // Async.cpp
 #include "Async.hpp"
 
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <memory>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
 namespace blxcpp {
 
+namespace {
+
+int epollWait(int epoll_fd, struct epoll_event *events, int max, int64_t timeout) {
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+    // epoll_pwait2 能睡不到一毫秒, 内核太老 (5.11 以前) 的时候退回 epoll_wait
+    static std::atomic<bool> supported(true);
+    if (supported.load(std::memory_order_relaxed)) {
+        struct timespec ts;
+        ts.tv_sec = timeout / 1000000;
+        ts.tv_nsec = (timeout % 1000000) * 1000;
+        int count = epoll_pwait2(epoll_fd, events, max, timeout < 0 ? nullptr : &ts, nullptr);
+        if (count >= 0 || errno != ENOSYS) return count;
+        supported.store(false, std::memory_order_relaxed);
+    }
+#endif
+    // 只能精确到毫秒, 向上取整, timer 宁可晚一点也不能提前醒了空转
+    int64_t millis = timeout < 0 ? -1 : (timeout + 999) / 1000;
+    return epoll_wait(epoll_fd, events, max, static_cast<int>(std::min<int64_t>(millis, INT_MAX)));
+}
+
+}
+
 // init
 AsyncEventLoop* AsyncEventLoop::global = nullptr;
 std::sig_atomic_t AsyncEventLoop::singal = 0;
 
 void eventLoop() {
+    AsyncEventLoop* event_loop = AsyncEventLoop::getGlobal();
     std::signal(SIGINT, [](int i){
         AsyncEventLoop::singal = i;
+        AsyncEventLoop::getGlobal()->wakeup();
     });
-    AsyncEventLoop::getGlobal()->epoll(6, [](){
+    event_loop->epoll(-1, [](){
         return AsyncEventLoop::singal > 0;
     });
 }
 
-Timer::Ref setInterval(Timer::Time t, const std::function<void ()> &func) {
-    return AsyncEventLoop::getGlobal()->setInterval(t, func);
+Timer::Ref setInterval(Timer::Time t, const std::function<void ()> &func, Timer::Time slack) {
+    return AsyncEventLoop::getGlobal()->setInterval(t, func, slack);
+}
+
+Timer::Ref setTimeout(Timer::Time t, const std::function<void ()> &func, Timer::Time slack) {
+    return AsyncEventLoop::getGlobal()->setTimeout(t, func, slack);
+}
+
+AsyncEventLoop::AsyncEventLoop()
+    : AsyncEventLoop(std::thread::hardware_concurrency()) { }
+
+AsyncEventLoop::AsyncEventLoop(size_t threads)
+    : m_loop_thread(std::thread::id())
+    , m_owner(std::this_thread::get_id())
+    , m_refs(0)
+    , m_budget(256)
+    , m_capacity(0)
+    , m_overflow(Overflow::Block)
+    , m_high_watermark(0)
+    , m_low_watermark(0)
+    , m_queued(0)
+    , m_above_watermark(false)
+    , m_dropped(0)
+    , m_popping(false)
+    , m_blocked(0)
+    , m_closing(false)
+    , m_thread_pool(threads)
+    , m_epoll_fd(epoll_create1(EPOLL_CLOEXEC))
+    , m_event_fd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , m_polling(false)
+    , m_time_source(TimeSource::Steady)
+    , m_cached_time(false)
+    , m_now(Clock::steady())
+    , m_ring(new IoUring(256))
+    , m_io_pending(0)
+    , m_io_requests(nullptr) {
+    if (m_epoll_fd < 0 || m_event_fd < 0) {
+        throw std::runtime_error("AsyncEventLoop: can not create epoll / eventfd.");
+    }
+
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = m_event_fd;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_event_fd, &event);
+
+    // io_uring 的 fd 在有完成事件时可读, 放进 epoll 里就不用另外等它
+    if (m_ring->valid()) {
+        event.data.fd = m_ring->fd();
+        epoll_ctl(m_epoll_fd, EPOLL_CTL_ADD, m_ring->fd(), &event);
+    } else {
+        m_ring.reset();
+    }
+
+    // 线程池里的任务全部跑完的时候也要叫醒一下, 事件循环可能在等它退出
+    auto event_loop = this;
+    m_thread_pool.on_idle([event_loop](){ event_loop->wakeup(); });
 }
 
-Timer::Ref setTimeout(Timer::Time t, const std::function<void ()> &func) {
-    return AsyncEventLoop::getGlobal()->setTimeout(t, func);
+AsyncEventLoop::~AsyncEventLoop() {
+    // 还在等空位的生产者放行, 不然下面等线程池的时候会互相卡住
+    {
+        std::lock_guard<std::mutex> sp(m_full_lock);
+        m_closing.store(true);
+    }
+    m_not_full.notify_all();
+
+    // 还没跑完的任务会往这里推事件, 要等它们结束才能关掉 fd
+    m_thread_pool.wait_idle();
+
+    // 没等到完成就退出的请求 (比如一直没人连进来的 accept, 一直没数据的 socket), 不取消的话会一直等下去
+    // 先全部取消, 内核可能还在用 buf, 所以还是要等它们以 -ECANCELED 结束, 但不再回调
+    for (IoRequest* request = m_io_requests; request; request = request->m_next) {
+        if (m_ring->prepare(IoUring::Cancel, -1, request, 0, -1, CancelTag)) continue;
+        m_ring->submit();
+        m_ring->prepare(IoUring::Cancel, -1, request, 0, -1, CancelTag);
+    }
+    while (m_io_pending > 0 && m_ring->submit(1) >= 0) {
+        uint64_t data;
+        int res;
+        while (m_ring->pop(data, res)) {
+            if (data == CancelTag) continue;
+            IoRequest* request = reinterpret_cast<IoRequest*>(data);
+            unlinkIo(request);
+            delete request;
+            m_io_pending--;
+        }
+    }
+    m_ring.reset();
+
+    // evictOldest 取出来留着的内部事件, 不会再有人跑了
+    for (EventNode* node : m_kept) delete node;
+
+    close(m_event_fd);
+    close(m_epoll_fd);
 }
 
 void AsyncEventLoop::epoll() {
-    return epoll(6, [](){ return false; });
+    return epoll(-1, [](){ return false; });
 }
 
 void AsyncEventLoop::epoll(int64_t interval, const std::function<bool ()> &stop){
-    while (!stop() && (m_thread_pool.busy() || !m_queue.empty() || !m_timer.empty())) {
+    bindToCurrentThread();
+    m_loop_thread.store(std::this_thread::get_id());
 
-        m_timer.tick(Timer::now());
+    while (!stop() && alive()) {
 
-        Event event;
-        {
-            std::lock_guard<std::mutex> sp(m_queue_lock);
-            if (m_queue.size() == 0) continue;
+        // 缓存时间模式下这一轮剩下的地方都用这个时间, 不再读时钟
+        tickTimer();
+        runNextTicks();
+
+        size_t count = reapIo();
+
+        // 一个一个从无锁队列里取, 生产者那边不会和这里抢锁
+        for (size_t i = 0; m_budget == 0 || i < m_budget; i++) {
+            std::unique_ptr<EventNode> node(popEvent());
+            if (!node) break;
+            size_t queued = m_queued.fetch_sub(1);
+            released(queued - 1);
+            if (node->m_droppable && m_overflow == Overflow::DropOldest && m_capacity > 0 && queued > m_capacity) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            node->m_task();
+            count++;
+            runNextTicks();
+        }
 
-            event = m_queue.front();
-            m_queue.pop_front();
+        // 这一轮准备好的 io 请求一次性交给内核
+        if (m_ring) m_ring->submit();
+
+        // 一直有事件的时候也要顺便看一眼 fd, 不然 watcher 会被饿死
+        if (count > 0) {
+            if (!m_watchers.empty()) poll(0);
+            continue;
         }
 
+        wait(interval);
+    }
+
+    m_loop_thread.store(std::thread::id());
+}
+
+bool AsyncEventLoop::alive() {
+    return m_thread_pool.pending() > 0 || hasEvents() || !m_timer.empty() || !m_watchers.empty()
+            || m_io_pending > 0 || m_refs.load() > 0;
+}
+
+bool AsyncEventLoop::hasEvents() {
+    // m_queue 可能正被 evictOldest 取着, 这里只看计数; 计数先于入队, 最多多转一圈
+    return !m_next_ticks.empty() || m_queued.load() > 0 || m_timer.pending();
+}
+
+void AsyncEventLoop::runNextTicks() {
+    // 微任务里再 pushNextTick 的也在这一轮执行完
+    while (!m_next_ticks.empty()) {
+        Event event = std::move(m_next_ticks.front());
+        m_next_ticks.pop_front();
         event();
-        std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+    }
+}
+
+void AsyncEventLoop::ref() {
+    m_refs.fetch_add(1);
+}
+
+void AsyncEventLoop::unref() {
+    // 最后一个 ref 没了, 叫醒事件循环看看是不是该退出了
+    if (m_refs.fetch_sub(1) == 1) wakeup();
+}
+
+void AsyncEventLoop::setCapacity(size_t capacity, Overflow overflow) {
+    m_capacity = capacity;
+    m_overflow = overflow;
+}
+
+void AsyncEventLoop::setWatermarks(size_t high, size_t low, const std::function<void (bool)> &callback) {
+    m_high_watermark = high;
+    m_low_watermark = std::min(low, high);
+    m_on_watermark = callback;
+}
+
+size_t AsyncEventLoop::queued() const {
+    return m_queued.load();
+}
+
+uint64_t AsyncEventLoop::dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
+
+bool AsyncEventLoop::reserve(Admission admission) {
+    if (m_capacity == 0) {
+        m_queued.fetch_add(1);
+        return true;
+    }
+
+    size_t queued = m_queued.load();
+    while (true) {
+        if (queued < m_capacity) {
+            if (m_queued.compare_exchange_weak(queued, queued + 1)) return true;
+            continue;
+        }
+
+        if (admission == Admission::Try) return false;
+        if (admission == Admission::User && m_overflow == Overflow::Reject) return false;
+
+        // 事件循环卡在一个很长的事件里的时候没人去丢, 到了两倍容量就自己丢最老的, 不然内存没有上限
+        if (admission == Admission::User && m_overflow == Overflow::DropOldest && queued >= m_capacity * 2) {
+            if (!evictOldest()) {
+                // 一个能丢的都没有, 新来的就是最老的
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            queued = m_queued.load();
+            continue;
+        }
 
+        // DropOldest 留给事件循环去丢; 事件循环线程自己等, 或者事件循环还没在跑, 都没人腾位置
+        bool running = m_loop_thread.load() != std::thread::id();
+        if (m_overflow != Overflow::Block || inLoopThread() || !running || m_closing.load()) {
+            m_queued.fetch_add(1);
+            return true;
+        }
+
+        {
+            std::unique_lock<std::mutex> locker(m_full_lock);
+            m_blocked++;
+            m_not_full.wait(locker, [this](){ return m_queued.load() < m_capacity || m_closing.load(); });
+            m_blocked--;
+        }
+        queued = m_queued.load();
+    }
+}
+
+AsyncEventLoop::EventNode *AsyncEventLoop::popEvent() {
+    // 只有 DropOldest 的时候生产者才会来抢, 其他策略不用碰标记
+    if (m_overflow != Overflow::DropOldest || m_capacity == 0) return m_queue.pop();
+
+    while (m_popping.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+    EventNode* node;
+    if (!m_kept.empty()) {
+        node = m_kept.front();
+        m_kept.pop_front();
+    } else {
+        node = m_queue.pop();
+    }
+    m_popping.store(false, std::memory_order_release);
+    return node;
+}
+
+bool AsyncEventLoop::evictOldest() {
+    while (m_popping.exchange(true, std::memory_order_acquire)) std::this_thread::yield();
+    EventNode* victim = nullptr;
+    // 别的生产者 exchange 完还没链上的那一瞬间 pop 会落空, 这时 empty() 还是 false, 再取一次
+    while (victim == nullptr && !m_queue.empty()) {
+        EventNode* node = m_queue.pop();
+        if (node == nullptr) continue;
+        if (node->m_droppable) victim = node;
+        else m_kept.push_back(node);
+    }
+    m_popping.store(false, std::memory_order_release);
+    if (victim == nullptr) return false;
+
+    delete victim;
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    released(m_queued.fetch_sub(1) - 1);
+    return true;
+}
+
+bool AsyncEventLoop::pushNode(EventNode *node, Admission admission) {
+    if (!reserve(admission)) {
+        delete node;
+        return false;
     }
+    m_queue.push(node);
+
+    if (m_high_watermark > 0 && m_queued.load() >= m_high_watermark && !m_above_watermark.exchange(true)) {
+        if (m_on_watermark) m_on_watermark(true);
+    }
+    wakeup();
+    return true;
 }
 
-void AsyncEventLoop::pushEvent(const AsyncEventLoop::Event &event) {
-    std::lock_guard<std::mutex> sp(m_queue_lock);
-    m_queue.push_back(event);
+void AsyncEventLoop::released(size_t queued) {
+    // 先减计数再看有没有人在等, 和 reserve 那边先登记再检查配对
+    if (m_blocked.load() > 0) {
+        std::lock_guard<std::mutex> sp(m_full_lock);
+        m_not_full.notify_one();
+    }
+    if (m_above_watermark.load() && queued <= m_low_watermark && m_above_watermark.exchange(false)) {
+        if (m_on_watermark) m_on_watermark(false);
+    }
+}
+
+void AsyncEventLoop::setBudget(size_t budget) {
+    m_budget = budget;
+}
+
+int64_t AsyncEventLoop::timeout(int64_t interval) {
+    // 最多睡到下一个 timer 到期, 单位是微秒
+    int64_t wait = -1;
+    Timer::Time next = m_timer.nextExpiry();
+    if (next >= 0) wait = std::max<int64_t>(0, next - now());
+    if (interval >= 0 && (wait < 0 || interval * 1000 < wait)) wait = interval * 1000;
+    return wait;
+}
+
+void AsyncEventLoop::wait(int64_t interval) {
+    // 先声明要睡了再检查一遍, 和 wakeup 那边先入队再看 m_polling 配对, 这样不会漏掉唤醒
+    m_polling.store(true);
+    if (hasEvents() || !alive()) {
+        m_polling.store(false);
+        return;
+    }
+
+    poll(timeout(interval));
+}
+
+void AsyncEventLoop::poll(int64_t timeout) {
+    struct epoll_event events[64];
+    int count = epollWait(m_epoll_fd, events, 64, timeout);
+    m_polling.store(false);
+
+    for (int i = 0; i < count; i++) {
+        int fd = events[i].data.fd;
+        if (m_ring && fd == m_ring->fd()) continue; // 下一轮循环开头统一收割
+        if (fd == m_event_fd) {
+            uint64_t value;
+            while (read(m_event_fd, &value, sizeof (value)) == sizeof (value)) { }
+            continue;
+        }
+
+        // 前面的回调可能已经 unwatch 了这个 fd, 每次都重新查, 回调也先拷出来再调用
+        uint32_t flags = events[i].events;
+        bool failed = flags & (EPOLLERR | EPOLLHUP);
+        if (flags & (EPOLLIN | EPOLLRDHUP) || failed) {
+            auto it = m_watchers.find(fd);
+            if (it != m_watchers.end() && it->second.m_on_read) {
+                std::function<void()> callback = it->second.m_on_read;
+                callback();
+            }
+        }
+        if (flags & EPOLLOUT || failed) {
+            auto it = m_watchers.find(fd);
+            if (it != m_watchers.end() && it->second.m_on_write) {
+                std::function<void()> callback = it->second.m_on_write;
+                callback();
+            }
+        }
+    }
+}
+
+bool AsyncEventLoop::updateWatcher(int fd, bool added) {
+    Watcher& watcher = m_watchers[fd];
+    struct epoll_event event = {};
+    event.events = EPOLLET;
+    if (watcher.m_on_read) event.events |= EPOLLIN | EPOLLRDHUP;
+    if (watcher.m_on_write) event.events |= EPOLLOUT;
+    event.data.fd = fd;
+
+    if (epoll_ctl(m_epoll_fd, added ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, fd, &event) < 0) {
+        if (added) m_watchers.erase(fd);
+        return false;
+    }
+    return true;
+}
+
+bool AsyncEventLoop::watchRead(int fd, const std::function<void ()> &callback) {
+    bool added = m_watchers.find(fd) == m_watchers.end();
+    std::function<void()> old = m_watchers[fd].m_on_read;
+    m_watchers[fd].m_on_read = callback;
+    if (updateWatcher(fd, added)) return true;
+    if (!added) m_watchers[fd].m_on_read = old;
+    return false;
+}
+
+bool AsyncEventLoop::watchWrite(int fd, const std::function<void ()> &callback) {
+    bool added = m_watchers.find(fd) == m_watchers.end();
+    std::function<void()> old = m_watchers[fd].m_on_write;
+    m_watchers[fd].m_on_write = callback;
+    if (updateWatcher(fd, added)) return true;
+    if (!added) m_watchers[fd].m_on_write = old;
+    return false;
+}
+
+void AsyncEventLoop::unwatch(int fd) {
+    if (m_watchers.erase(fd) == 0) return;
+    epoll_ctl(m_epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void AsyncEventLoop::wakeup() {
+    // 只有事件循环真的在睡的时候才去写 eventfd, 平时推事件不用进内核
+    if (m_polling.exchange(false)) {
+        uint64_t one = 1;
+        ssize_t written = write(m_event_fd, &one, sizeof (one));
+        (void) written;
+    }
+}
+
+bool AsyncEventLoop::inLoopThread() const {
+    // 事件循环没在跑的时候也只认 owner, 不然线程池里的任务会和 owner 同时改 m_next_ticks / io_uring
+    return m_owner.load() == std::this_thread::get_id();
+}
+
+void AsyncEventLoop::bindToCurrentThread() {
+    m_owner.store(std::this_thread::get_id());
 }
 
 void AsyncEventLoop::pushNextTick(const AsyncEventLoop::Event &event) {
-    std::lock_guard<std::mutex> sp(m_queue_lock);
-    m_queue.push_front(event);
+    if (!inLoopThread()) {
+        pushEvent(event);
+        return;
+    }
+    m_next_ticks.push_back(event);
+}
+
+bool AsyncEventLoop::prepareIo(IoUring::Op op, int fd, void* buf, size_t len, int64_t offset, const IoCallback &callback) {
+    if (!m_ring) return false;
+
+    IoRequest* request = new IoRequest(callback);
+    uint64_t data = reinterpret_cast<uint64_t>(request);
+    if (!m_ring->prepare(op, fd, buf, len, offset, data)) {
+        // 提交队列满了, 先把这一批交出去再试一次
+        m_ring->submit();
+        if (!m_ring->prepare(op, fd, buf, len, offset, data)) {
+            delete request;
+            return false;
+        }
+    }
+    m_io_pending++;
+    request->m_next = m_io_requests;
+    if (m_io_requests) m_io_requests->m_prev = request;
+    m_io_requests = request;
+    return true;
+}
+
+void AsyncEventLoop::unlinkIo(AsyncEventLoop::IoRequest *request) {
+    if (request->m_prev) request->m_prev->m_next = request->m_next;
+    else m_io_requests = request->m_next;
+    if (request->m_next) request->m_next->m_prev = request->m_prev;
 }
 
-Timer::Ref AsyncEventLoop::setTimeout(Timer::Time t, const std::function<void ()> &func) {
+size_t AsyncEventLoop::reapIo() {
+    size_t count = 0;
+    uint64_t data;
+    int res;
+    while (m_ring && m_ring->pop(data, res)) {
+        if (data == CancelTag) continue;
+        std::unique_ptr<IoRequest> request(reinterpret_cast<IoRequest*>(data));
+        unlinkIo(request.get());
+        m_io_pending--;
+        count++;
+        request->m_callback(res);
+        runNextTicks();
+    }
+    return count;
+}
+
+void AsyncEventLoop::readAsync(int fd, void *buf, size_t len, int64_t offset, const IoCallback &callback) {
+    auto event_loop = this;
+    if (!inLoopThread()) {
+        postEvent(Event([event_loop, fd, buf, len, offset, callback](){
+            event_loop->readAsync(fd, buf, len, offset, callback);
+        }));
+        return;
+    }
+    if (prepareIo(IoUring::Read, fd, buf, len, offset, callback)) return;
+
+    m_thread_pool.put([event_loop, fd, buf, len, offset, callback](){
+        ssize_t n = offset < 0 ? read(fd, buf, len) : pread(fd, buf, len, offset);
+        int res = n < 0 ? -errno : static_cast<int>(n);
+        event_loop->postEvent(Event([callback, res](){ callback(res); }));
+    });
+}
+
+void AsyncEventLoop::writeAsync(int fd, const void *buf, size_t len, int64_t offset, const IoCallback &callback) {
     auto event_loop = this;
-    return m_timer.setTimeout(t, false, [event_loop, func](){
-        event_loop->m_queue.push_back(Event(func));
+    if (!inLoopThread()) {
+        postEvent(Event([event_loop, fd, buf, len, offset, callback](){
+            event_loop->writeAsync(fd, buf, len, offset, callback);
+        }));
+        return;
+    }
+    if (prepareIo(IoUring::Write, fd, const_cast<void*>(buf), len, offset, callback)) return;
+
+    m_thread_pool.put([event_loop, fd, buf, len, offset, callback](){
+        ssize_t n = offset < 0 ? write(fd, buf, len) : pwrite(fd, buf, len, offset);
+        int res = n < 0 ? -errno : static_cast<int>(n);
+        event_loop->postEvent(Event([callback, res](){ callback(res); }));
     });
 }
 
-Timer::Ref AsyncEventLoop::setInterval(Timer::Time t, const std::function<void ()> &func) {
+void AsyncEventLoop::acceptAsync(int fd, const IoCallback &callback) {
     auto event_loop = this;
-    return m_timer.setTimeout(t, true, [event_loop, func](){
-        event_loop->m_queue.push_back(Event(func));
+    if (!inLoopThread()) {
+        postEvent(Event([event_loop, fd, callback](){
+            event_loop->acceptAsync(fd, callback);
+        }));
+        return;
+    }
+    if (prepareIo(IoUring::Accept, fd, nullptr, 0, -1, callback)) return;
+
+    m_thread_pool.put([event_loop, fd, callback](){
+        int client = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+        int res = client < 0 ? -errno : client;
+        event_loop->postEvent(Event([callback, res](){ callback(res); }));
     });
 }
 
+bool AsyncEventLoop::hasIoUring() const {
+    return m_ring != nullptr;
+}
+
+Timer::Time AsyncEventLoop::clock() const {
+    return m_time_source == TimeSource::Tsc ? Clock::tsc() : Clock::steady();
+}
+
+Timer::Time AsyncEventLoop::now() const {
+    return m_cached_time ? m_now : clock();
+}
+
+void AsyncEventLoop::setTimeSource(TimeSource source, bool cached) {
+    m_time_source = source;
+    m_cached_time = cached;
+    // tsc 第一次用的时候要校准, 不要拖到事件循环里
+    if (source == TimeSource::Tsc) Clock::hasTsc();
+    m_now = clock();
+}
+
+void AsyncEventLoop::setTimerResolution(Timer::Time micros) {
+    m_timer.setResolution(micros);
+}
+
+void AsyncEventLoop::tickTimer() {
+    m_now = clock();
+    m_timer.tick(m_now);
+    if (m_expired.empty()) return;
+
+    // 一次 tick 到期的回调只投递一个事件, 一个一个投的话每个都要分配节点、抢一次队列
+    std::vector<std::function<void()>> expired;
+    expired.swap(m_expired);
+    postEvent([expired = std::move(expired)](){
+        for (auto& func : expired) func();
+    });
+}
+
+Timer::Ref AsyncEventLoop::setTimeout(Timer::Time t, const std::function<void ()> &func, Timer::Time slack) {
+    return setTimeoutMicros(t * 1000, func, slack * 1000);
+}
+
+Timer::Ref AsyncEventLoop::setInterval(Timer::Time t, const std::function<void ()> &func, Timer::Time slack) {
+    return setIntervalMicros(t * 1000, func, slack * 1000);
+}
+
+Timer::Ref AsyncEventLoop::setTimeoutMicros(Timer::Time t, const std::function<void ()> &func, Timer::Time slack) {
+    auto event_loop = this;
+    Timer::Ref ref = m_timer.setTimeout(t, false, [event_loop, func](){
+        event_loop->m_expired.push_back(func);
+    }, slack);
+    // 其他线程设的 timer 要等事件循环下一次 tick 才生效, 叫醒它重新算等待时间
+    wakeup();
+    return ref;
+}
+
+Timer::Ref AsyncEventLoop::setIntervalMicros(Timer::Time t, const std::function<void ()> &func, Timer::Time slack) {
+    auto event_loop = this;
+    Timer::Ref ref = m_timer.setTimeout(t, true, [event_loop, func](){
+        event_loop->m_expired.push_back(func);
+    }, slack);
+    wakeup();
+    return ref;
+}
+
+void AsyncEventLoop::armTimer(Timer::Node &node, Timer::Time t, bool repeat, Timer::Time slack) {
+    m_timer.arm(node, t, repeat, slack);
+}
+
 AsyncEventLoop *AsyncEventLoop::getGlobal(){
     if (global == nullptr) {
         global = new AsyncEventLoop();
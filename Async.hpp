@@ -5,14 +5,24 @@
 #include "function_traits.hpp"
 #include "Timer.hpp"
 #include "ThreadPool.hpp"
+#include "MpscQueue.hpp"
+#include "UniqueTask.hpp"
+#include "IoUring.hpp"
+#include "Future.hpp"
+#include "tuple_helper.hpp"
 
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
 #include <csignal>
 #include <chrono>
 #include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <exception>
 #include <iostream>
 
 
@@ -38,26 +48,227 @@ public:
     template <typename Arg, typename Ret>
     class Continuation;
 
+    // 结果 >= 0 是读写的字节数或者 accept 到的新 fd, < 0 是 -errno
+    using IoCallback = std::function<void(int)>;
+
+    // 和线程池一样的溢出策略, 见 setCapacity
+    using Overflow = ThreadPool::Overflow;
+
+    // timer 用哪个时钟, 见 setTimeSource
+    enum class TimeSource { Steady, Tsc };
+
 private:
-    std::mutex m_queue_lock;
-    std::deque<Event> m_queue;
+    struct EventNode : MpscNode {
+        UniqueTask m_task;
+        bool m_droppable; // 内部的完成事件 (回调, 协程恢复, io 结果) 不能丢
+
+        template<typename Func>
+        EventNode(Func&& func, bool droppable)
+            : m_task(std::forward<Func>(func)), m_droppable(droppable) { }
+    };
+
+    // User: pushEvent, 按 m_overflow 处理; Try: 满了就拒绝
+    // Internal: 事件循环自己产生的事件, 不拒绝也不丢, 只有 Block 策略时会等
+    enum class Admission { User, Try, Internal };
+
+    friend class AsyncRuntime;
+
+    // 其他线程推进来的事件, 无锁多生产者单消费者, 只有事件循环线程会取
+    MpscQueue<EventNode> m_queue;
+    // nextTick 的微任务队列, 只在事件循环线程上访问, 每个事件执行完以后清空
+    std::deque<Event> m_next_ticks;
+    std::atomic<std::thread::id> m_loop_thread; // 正在跑 epoll 的线程, 没在跑时是默认值
+    // 拥有 m_next_ticks, io_uring 和 watcher 的线程: 一开始是构造的线程, epoll 启动时换成跑 epoll 的线程
+    // 事件循环停了以后也不清掉, 其他线程一律走事件队列
+    std::atomic<std::thread::id> m_owner;
+    std::atomic<size_t> m_refs; // ref() 的次数, 大于 0 的时候没事做也不退出
+    size_t m_budget;            // 每轮最多执行多少个事件, 0 表示不限
+
+    // 事件队列的容量和水位线, 见 setCapacity / setWatermarks
+    size_t m_capacity;
+    Overflow m_overflow;
+    size_t m_high_watermark;
+    size_t m_low_watermark;
+    std::function<void(bool)> m_on_watermark;
+    std::atomic<size_t> m_queued; // m_queue 里的事件数
+    std::atomic<bool> m_above_watermark;
+    std::atomic<uint64_t> m_dropped;
+    // DropOldest 时生产者也可能从 m_queue 里取 (见 evictOldest), 谁拿到这个标记谁才能取
+    // 取出来但是不能丢的内部事件按原来的顺序放在 m_kept, 事件循环先跑它们, 也由这个标记保护
+    std::atomic<bool> m_popping;
+    std::deque<EventNode*> m_kept;
+    std::mutex m_full_lock;
+    std::condition_variable m_not_full;
+    std::atomic<int> m_blocked; // 等空位的生产者数
+    std::atomic<bool> m_closing;
     ThreadPool m_thread_pool;
     Timer m_timer;
+    std::vector<std::function<void()>> m_expired; // 这次 tick 到期的 setTimeout 回调, 攒起来一起投递
+
+    // 没事做的时候阻塞在 epoll_wait 上, 靠 eventfd 叫醒 (只支持 linux)
+    int m_epoll_fd;
+    int m_event_fd;
+    std::atomic<bool> m_polling; // 事件循环是否 (即将) 阻塞在 epoll_wait 上
+
+    TimeSource m_time_source;
+    bool m_cached_time;
+    Timer::Time m_now; // 这一轮循环开始时读的时间, 只在事件循环线程上访问
+
+    struct Watcher {
+        std::function<void()> m_on_read;
+        std::function<void()> m_on_write;
+    };
+
+    // 用户注册的 fd, 只在事件循环线程上访问
+    std::map<int, Watcher> m_watchers;
+
+    struct IoRequest {
+        IoCallback m_callback;
+        // 还没完成的请求串成链表, 析构的时候要一个个取消
+        IoRequest* m_prev;
+        IoRequest* m_next;
+
+        explicit IoRequest(const IoCallback& callback)
+            : m_callback(callback), m_prev(nullptr), m_next(nullptr) { }
+    };
+
+    // 取消请求自己的 user_data, 完成的时候直接忽略
+    static const uint64_t CancelTag = 0;
+
+    // 内核不支持的时候是 nullptr, 读写退化到线程池里做
+    std::unique_ptr<IoUring> m_ring;
+    size_t m_io_pending; // 已经交给 io_uring 还没完成的请求
+    IoRequest* m_io_requests;
+
+    bool alive();
+    bool hasEvents();
+    void runNextTicks();
+    Timer::Time clock() const;
+    void tickTimer();
+    int64_t timeout(int64_t interval);
+    void wait(int64_t interval);
+    void poll(int64_t timeout);
+    bool updateWatcher(int fd, bool added);
+    bool inLoopThread() const;
+    bool reserve(Admission admission);
+    EventNode* popEvent();
+    bool evictOldest();
+    bool pushNode(EventNode* node, Admission admission);
+    void released(size_t queued);
+
+    template<typename Func>
+    void postEvent(Func&& func) {
+        pushNode(new EventNode(std::forward<Func>(func), false), Admission::Internal);
+    }
+    bool prepareIo(IoUring::Op op, int fd, void* buf, size_t len, int64_t offset, const IoCallback& callback);
+    size_t reapIo();
+    void unlinkIo(IoRequest* request);
 
 public:
 
+    AsyncEventLoop();
+    // threads 是自带线程池的线程数
+    explicit AsyncEventLoop(size_t threads);
+    ~AsyncEventLoop();
+
     template<typename Func>
     inline Async<typename function_traits<Func>::function_type> async(const Func& func) {
         return Async<typename function_traits<Func>::function_type>(this, func);
     }
 
      void epoll();
-     void epoll(int64_t interval, const std::function<bool()>& stop);
-     void pushEvent(const Event& event);
 
+     // interval 是单次阻塞等待的上限 (毫秒), -1 表示只等事件和下一个 timer 到期
+     void epoll(int64_t interval, const std::function<bool()>& stop);
+     // 任意可调用对象都可以, 只移动不拷贝, 所以只能移动的函数对象也行, 线程安全
+     // 队列满了并且策略是 Reject, 或者 DropOldest 到了两倍容量的时候返回 false
+     template<typename Func>
+     bool pushEvent(Func&& func) {
+         return pushNode(new EventNode(std::forward<Func>(func), true), Admission::User);
+     }
+
+     // 不管什么策略, 满了就返回 false
+     template<typename Func>
+     bool tryPushEvent(Func&& func) {
+         return pushNode(new EventNode(std::forward<Func>(func), true), Admission::Try);
+     }
+
+    // 事件队列的容量, 0 表示不限 (默认), 要在开始投递事件之前设置
+    // Block: 其他线程的 pushEvent 等到有空位, 事件循环线程自己 (或者事件循环还没启动时) 不等
+    // Reject: pushEvent 返回 false
+    // DropOldest: 事件循环取事件时发现超出容量, 就把最老的 pushEvent 事件直接丢掉, 所以队列可能超出容量;
+    //   事件循环卡住没人丢的时候, 队列到了两倍容量, 投递的线程自己把最老的 pushEvent 事件丢掉再放进去,
+    //   丢掉的事件在投递的线程上析构; 队列里一个能丢的都没有的话, 新来的就是最老的, pushEvent 返回 false
+    //   两种丢法都计入 dropped
+    // 内部产生的完成事件 (async 回调, io 结果, timer, 协程恢复) 不会被拒绝或者丢掉, 只会在 Block 时等
+    void setCapacity(size_t capacity, Overflow overflow = Overflow::Block);
+
+    // 队列长度涨到 high 时回调 callback(true), 回落到 low 时回调 callback(false)
+    // 涨的一边在投递的线程上回调, 落的一边在事件循环线程上回调, 要在开始投递事件之前设置
+    void setWatermarks(size_t high, size_t low, const std::function<void(bool)>& callback);
+
+    size_t queued() const;
+    uint64_t dropped() const;
+
+    // 把事件循环交给当前线程, 之后 pushNextTick / readAsync 这些只有在这个线程上才直接执行
+    // 在别的线程构造、事件循环启动之前要在将来跑 epoll 的线程上先用的时候调用; epoll 启动时也会自动调用
+    void bindToCurrentThread();
+
+    // 叫醒阻塞中的事件循环, 线程安全, 也可以在信号处理函数里调用
+    void wakeup();
+
+    // 和 libuv 的 handle 一样, 有 ref 的时候事件循环空着也不会退出, 线程安全
+    void ref();
+    void unref();
+
+    // 每轮循环最多执行多少个事件, 执行完这么多就先去处理 timer, 剩下的下一轮接着跑
+    void setBudget(size_t budget);
+
+    // 在当前事件执行完、下一个事件开始之前执行
+    // 只应该在事件循环线程上调用, 其他线程调用时退化成 pushEvent
     void pushNextTick(const Event& event);
-    Timer::Ref setTimeout(Timer::Time t, const std::function<void()>& func);
-    Timer::Ref setInterval(Timer::Time t, const std::function<void()>& func);
+
+    // 边沿触发: fd 从不可读变成可读 (或者出错 / 对端关闭) 时回调一次,
+    // 回调里要一直读到 EAGAIN, 否则不会再收到通知, fd 应该设成非阻塞
+    // 只能在事件循环线程上调用 (或者事件循环启动之前), 有 fd 在监听时事件循环不会退出
+    // 同一个 fd 再调用一次会替换回调; epoll 不支持的 fd (比如普通文件) 返回 false
+    bool watchRead(int fd, const std::function<void()>& callback);
+    bool watchWrite(int fd, const std::function<void()>& callback);
+    // 关闭 fd 之前要先 unwatch, 回调里 unwatch 自己也是安全的
+    void unwatch(int fd);
+
+    // 真正异步的读写, 有 io_uring 的时候请求攒到这一轮循环结束再一起提交
+    // 没有 io_uring 的时候在线程池里阻塞调用, 所以 socket 最好还是配合 watchRead 用
+    // buf 在回调之前必须一直有效, offset 为 -1 表示用 fd 当前的位置 (socket / pipe 只能传 -1)
+    // 回调总在事件循环线程上执行, 其他线程调用会先转到事件循环线程上再提交
+    void readAsync(int fd, void* buf, size_t len, int64_t offset, const IoCallback& callback);
+    void writeAsync(int fd, const void* buf, size_t len, int64_t offset, const IoCallback& callback);
+    void acceptAsync(int fd, const IoCallback& callback);
+    bool hasIoUring() const;
+
+    // 单位是毫秒, slack 是允许晚多少毫秒触发, 见 Timer::setTimeout
+    // 同一次 tick 里到期的 timer 合成一个事件一起执行, 大量心跳用上 slack 就能少醒很多次
+    Timer::Ref setTimeout(Timer::Time t, const std::function<void()>& func, Timer::Time slack = 0);
+    Timer::Ref setInterval(Timer::Time t, const std::function<void()>& func, Timer::Time slack = 0);
+    // 单位是微秒, 实际精度取决于 setTimerResolution
+    Timer::Ref setTimeoutMicros(Timer::Time t, const std::function<void()>& func, Timer::Time slack = 0);
+    Timer::Ref setIntervalMicros(Timer::Time t, const std::function<void()>& func, Timer::Time slack = 0);
+
+    // 侵入式 timer, 节点由调用方持有, 见 Timer::Node, 单位是微秒
+    // 只能在事件循环线程上调用, 回调直接在 tick 里执行, 不经过事件队列
+    // 之后用 node.cancel() / node.reschedule() 取消或者重新计时
+    void armTimer(Timer::Node& node, Timer::Time t, bool repeat = false, Timer::Time slack = 0);
+
+    // timer 时间轮一个槽的宽度 (微秒), 默认 1000, 要在设置 timer 之前调用
+    void setTimerResolution(Timer::Time micros);
+
+    // cached 为 true 时每轮循环只读一次时钟, timer 和等待时间都按这一轮开始的时间算,
+    // 事件执行得久的话 timer 会相应地晚一点; Tsc 在不支持的机器上就是 Steady
+    // 要在事件循环启动之前调用
+    void setTimeSource(TimeSource source, bool cached = false);
+
+    // 当前时间 (微秒), 缓存模式下是这一轮循环开始的时间
+    Timer::Time now() const;
 
 private:
     static AsyncEventLoop* global;
@@ -71,9 +282,10 @@ template <typename Ret, typename ...Args>
 class AsyncEventLoop::Async<Ret(Args...)> {
 public:
 
+    // 回调拿到的是结果的右值, 可以直接移走
     template<typename, typename Arg>
     struct MakeCallback {
-        using type = void(Arg);
+        using type = void(Arg&&);
     };
 
     template<typename IGNORE>
@@ -83,50 +295,145 @@ public:
 
     using Callback = std::function<typename MakeCallback<void, Ret>::type>;
     using Func = std::function<Ret(Args...)>;
+    using Arguments = std::tuple<typename std::decay<Args>::type...>;
 
 private:
 
+    using ArgIndexes = typename MakeIndexes<sizeof...(Args)>::type;
+
     AsyncEventLoop* m_event_loop;
     std::function<Ret(Args...)> m_func;
 
-    template<typename, bool EmptyReturn>
-    struct Runer;
+    template<typename U>
+    struct Tag { };
 
-    template<typename IGNORE>
-    struct Runer<IGNORE, true> {
-        static void run(AsyncEventLoop* event_loop, const Func& func, const Callback& callback, Args... args){
-            event_loop->m_thread_pool.put(std::bind([event_loop, func, callback](Args... args){
-                func(std::forward<Args>(args)...);
-                Event event = callback;
-                event_loop->pushEvent(event);
-            }, std::forward<Args>(args)...));
-        }
+    // 按声明的参数类型转发: 按值的参数移动进去, T& 的参数拿到存着的那份的左值
+    template<int ...Indexes>
+    static Ret apply(Func& func, Arguments& args, IndexTuple<Indexes...>) {
+        return func(static_cast<Args&&>(std::get<Indexes>(args))...);
+    }
+
+    // 结果带回事件循环线程的事件
+    class Result {
+    private:
+        Callback m_callback;
+        Ret m_value;
+
+    public:
+        Result(Callback&& callback, Ret&& value)
+            : m_callback(std::move(callback)), m_value(std::move(value)) { }
+
+        void operator()() { m_callback(std::move(m_value)); }
     };
 
-    template<typename IGNORE>
-    struct Runer<IGNORE, false> {
-        static void run(AsyncEventLoop* event_loop, const Func& func, const Callback& callback, Args... args){
-            event_loop->m_thread_pool.put(std::bind([event_loop, func, callback](Args... args){
-                Event event = std::function<void()>(std::bind(callback, func(std::forward<Args>(args)...)));
-                event_loop->pushEvent(event);
-            }, std::forward<Args>(args)...));
+    // 投递到线程池里的任务本体, 参数从调用者一路移动到 func, 结果再移动到回调, 中间不拷贝
+    // 没有回调的就是不关心结果, 执行完什么都不推
+    class Job {
+    private:
+        AsyncEventLoop* m_event_loop;
+        Func m_func;
+        Callback m_callback;
+        Arguments m_args;
+
+        template<typename U>
+        void run(Tag<U>) {
+            Ret value = apply(m_func, m_args, ArgIndexes());
+            if (m_callback) m_event_loop->postEvent(Result(std::move(m_callback), std::move(value)));
         }
-    };
 
+        void run(Tag<void>) {
+            apply(m_func, m_args, ArgIndexes());
+            if (m_callback) m_event_loop->postEvent(std::move(m_callback));
+        }
+
+    public:
+        Job(AsyncEventLoop* event_loop, Func&& func, Callback&& callback, Arguments&& args)
+            : m_event_loop(event_loop)
+            , m_func(std::move(func))
+            , m_callback(std::move(callback))
+            , m_args(std::move(args)) { }
+
+        void operator()() { run(Tag<Ret>()); }
+    };
 
 public:
 
+    // operator()(args...) 的返回值
+    // 直接丢掉的话在析构的时候投递到线程池, 和以前一样不关心结果
+    // C++20 下可以 co_await 它 (见 Coroutine.hpp): 在线程池里执行完以后回到事件循环线程上恢复协程,
+    // 结果和异常都存在这个对象里, 它本身就活在协程帧里, 不用额外分配
+    class Call {
+    private:
+        AsyncEventLoop* m_event_loop;
+        Func m_func;
+        Arguments m_args;
+        bool m_started;
+        FutureValue<Ret> m_value;
+        std::exception_ptr m_error;
+
+        template<typename U>
+        void invoke(Tag<U>) { m_value.set(apply(m_func, m_args, ArgIndexes())); }
+
+        void invoke(Tag<void>) {
+            apply(m_func, m_args, ArgIndexes());
+            m_value.set();
+        }
+
+    public:
+        template<typename ...A>
+        Call(AsyncEventLoop* event_loop, const Func& func, A&&... args)
+            : m_event_loop(event_loop), m_func(func), m_args(std::forward<A>(args)...), m_started(false) { }
+
+        Call(Call&& other)
+            : m_event_loop(other.m_event_loop)
+            , m_func(std::move(other.m_func))
+            , m_args(std::move(other.m_args))
+            , m_started(other.m_started) {
+            other.m_started = true;
+        }
+
+        Call(const Call&) = delete;
+        Call& operator=(const Call&) = delete;
+
+        ~Call() {
+            if (!m_started) {
+                m_event_loop->m_thread_pool.put(Job(m_event_loop, std::move(m_func), Callback(), std::move(m_args)));
+            }
+        }
+
+        bool await_ready() const { return false; }
+
+        template<typename Handle>
+        void await_suspend(Handle handle) {
+            m_started = true;
+            Call* call = this;
+            AsyncEventLoop* event_loop = m_event_loop;
+            event_loop->m_thread_pool.put([call, event_loop, handle](){
+                try {
+                    call->invoke(Tag<Ret>());
+                } catch (...) {
+                    call->m_error = std::current_exception();
+                }
+                event_loop->postEvent([handle](){ handle.resume(); });
+            });
+        }
+
+        Ret await_resume() {
+            if (m_error) std::rethrow_exception(m_error);
+            return m_value.take();
+        }
+    };
+
     Async(AsyncEventLoop* event_loop, const std::function<Ret(Args...)>& func)
         : m_event_loop(event_loop), m_func(func) { }
 
-    void operator()(Args... args, const Callback& callback) {
-        auto func = m_func;
-        AsyncEventLoop* event_loop = m_event_loop;
-        Runer<void, std::is_same<Ret, void>::value>::run(event_loop, func, callback, std::forward<Args>(args)...);
+    void operator()(Args... args, Callback callback) {
+        m_event_loop->m_thread_pool.put(Job(m_event_loop, Func(m_func), std::move(callback),
+                                            Arguments(std::forward<Args>(args)...)));
     }
 
-    void operator()(Args... args) {
-        m_event_loop->m_thread_pool.put(std::bind(m_func, std::forward<Args>(args)...));
+    Call operator()(Args... args) {
+        return Call(m_event_loop, m_func, std::forward<Args>(args)...);
     }
 
     Ret sync(Args... args) {
@@ -141,8 +448,8 @@ auto async(const Func& func) -> decltype (AsyncEventLoop::getGlobal()->async(fun
     return AsyncEventLoop::getGlobal()->async(func);
 }
 
-Timer::Ref setTimeout(Timer::Time t, const std::function<void()>& func);
-Timer::Ref setInterval(Timer::Time t, const std::function<void()>& func);
+Timer::Ref setTimeout(Timer::Time t, const std::function<void()>& func, Timer::Time slack = 0);
+Timer::Ref setInterval(Timer::Time t, const std::function<void()>& func, Timer::Time slack = 0);
 void eventLoop();
 
 
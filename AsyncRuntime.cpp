@@ -0,0 +1,117 @@
+// AsyncRuntime.cpp
+#include "AsyncRuntime.hpp"
+#include "Numa.hpp"
+
+namespace blxcpp {
+
+thread_local AsyncRuntime* AsyncRuntime::current_runtime = nullptr;
+thread_local size_t AsyncRuntime::current_shard = AsyncRuntime::NoShard;
+
+AsyncRuntime::AsyncRuntime()
+    : AsyncRuntime(Options()) { }
+
+AsyncRuntime::AsyncRuntime(const Options& options)
+    : m_next(0), m_stop(false) {
+    size_t count = options.shards > 0 ? options.shards : 1;
+
+    std::vector<int> cpus;
+    if (options.pin) {
+        for (const Numa::Node& node : Numa::nodes()) {
+            cpus.insert(cpus.end(), node.m_cpus.begin(), node.m_cpus.end());
+        }
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        std::unique_ptr<Shard> shard(new Shard());
+        shard->m_loop.reset(new AsyncEventLoop(options.pool_threads > 0 ? options.pool_threads : 1));
+        for (size_t j = 0; j < count; j++) {
+            // 自己发给自己的直接走 pushEvent, 不需要环形队列
+            shard->m_inbox.emplace_back(i == j ? nullptr : new SpscQueue<UniqueTask>(options.ring_capacity));
+        }
+        m_shards.push_back(std::move(shard));
+    }
+
+    // 所有分片都建好了再启动线程, 线程里会互相访问
+    for (size_t i = 0; i < count; i++) {
+        int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        m_shards[i]->m_thread = std::thread(&AsyncRuntime::run, this, i, cpu);
+    }
+}
+
+AsyncRuntime::~AsyncRuntime() {
+    stop();
+}
+
+void AsyncRuntime::run(size_t index, int cpu) {
+    if (cpu >= 0) Numa::pinCurrent(std::vector<int>(1, cpu));
+    current_runtime = this;
+    current_shard = index;
+
+    AsyncEventLoop& event_loop = *m_shards[index]->m_loop;
+    AsyncRuntime* runtime = this;
+    event_loop.ref();
+    event_loop.epoll(-1, [runtime](){ return runtime->m_stop.load(); });
+    event_loop.unref();
+
+    current_runtime = nullptr;
+    current_shard = NoShard;
+}
+
+size_t AsyncRuntime::currentShard() const {
+    return current_runtime == this ? current_shard : NoShard;
+}
+
+void AsyncRuntime::postTask(size_t shard, UniqueTask&& task) {
+    shard %= m_shards.size();
+    Shard& target = *m_shards[shard];
+
+    size_t from = currentShard();
+    if (from != NoShard && from != shard && target.m_inbox[from]->push(std::move(task))) {
+        schedule(target);
+        return;
+    }
+    // 环形队列满了的时候 push 不会动 task, 还可以接着交给 pushEvent
+    target.m_loop->pushEvent(std::move(task));
+}
+
+void AsyncRuntime::schedule(Shard& shard) {
+    // 环形队列从空变成非空时才需要通知一次, 一批消息只占一个 pushEvent
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.m_draining.exchange(true)) return;
+
+    AsyncRuntime* runtime = this;
+    Shard* target = &shard;
+    shard.m_loop->postEvent(Event([runtime, target](){ runtime->drain(*target); }));
+}
+
+void AsyncRuntime::drain(Shard& shard) {
+    while (true) {
+        UniqueTask task;
+        for (std::unique_ptr<SpscQueue<UniqueTask>>& inbox : shard.m_inbox) {
+            while (inbox && inbox->pop(task)) task();
+        }
+
+        // 先放下标记再检查一遍, 和 schedule 那边先入队再抢标记配对, 不会漏掉消息
+        shard.m_draining.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        bool empty = true;
+        for (std::unique_ptr<SpscQueue<UniqueTask>>& inbox : shard.m_inbox) {
+            if (inbox && !inbox->empty()) empty = false;
+        }
+        if (empty || shard.m_draining.exchange(true)) return;
+    }
+}
+
+void AsyncRuntime::stop() {
+    m_stop.store(true);
+    for (std::unique_ptr<Shard>& shard : m_shards) {
+        // 推一个空事件进去, 事件循环醒过来就会看到 m_stop
+        shard->m_loop->postEvent(Event([](){ }));
+    }
+    for (std::unique_ptr<Shard>& shard : m_shards) {
+        if (shard->m_thread.joinable()) shard->m_thread.join();
+    }
+}
+
+}
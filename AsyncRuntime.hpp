@@ -0,0 +1,92 @@
+// AsyncRuntime.hpp
+#ifndef BLXCPP_ASYNCRUNTIME_HPP
+#define BLXCPP_ASYNCRUNTIME_HPP
+
+#include "Async.hpp"
+#include "SpscQueue.hpp"
+#include "UniqueTask.hpp"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstddef>
+
+namespace blxcpp {
+
+// 每个核一个 AsyncEventLoop, 各自有自己的线程, timer, 事件队列和线程池, 互相不共享
+// 分片之间用 SPSC 环形队列发消息: 每一对 (来源, 目标) 一条, 只有一个生产者一个消费者
+// 不在分片线程上 post 的, 或者环形队列满了的, 退化成目标事件循环的 pushEvent
+// 这时同一来源发出的消息不再保证顺序
+class AsyncRuntime {
+public:
+    using Event = AsyncEventLoop::Event;
+
+    struct Options {
+        size_t shards = std::thread::hardware_concurrency();
+        size_t pool_threads = 1;    // 每个分片自带线程池的线程数
+        size_t ring_capacity = 1024; // 每条分片间环形队列的容量
+        bool pin = true;             // 分片线程依次绑到各个 CPU 上
+    };
+
+    static const size_t NoShard = size_t(-1);
+
+private:
+    struct Shard {
+        std::unique_ptr<AsyncEventLoop> m_loop;
+        std::thread m_thread;
+        std::vector<std::unique_ptr<SpscQueue<UniqueTask>>> m_inbox; // m_inbox[i] 是从第 i 个分片发来的
+        std::atomic<bool> m_draining; // 已经投递了 drain 事件, 还没执行完
+
+        Shard()
+            : m_draining(false) { }
+    };
+
+    std::vector<std::unique_ptr<Shard>> m_shards;
+    std::atomic<size_t> m_next;
+    std::atomic<bool> m_stop;
+
+    static thread_local AsyncRuntime* current_runtime;
+    static thread_local size_t current_shard;
+
+    void run(size_t index, int cpu);
+    void postTask(size_t shard, UniqueTask&& task);
+    void schedule(Shard& shard);
+    void drain(Shard& shard);
+
+public:
+    AsyncRuntime();
+    explicit AsyncRuntime(const Options& options);
+    ~AsyncRuntime();
+
+    AsyncRuntime(const AsyncRuntime&) = delete;
+    AsyncRuntime& operator=(const AsyncRuntime&) = delete;
+
+    size_t size() const { return m_shards.size(); }
+    AsyncEventLoop& loop(size_t shard) { return *m_shards[shard % m_shards.size()]->m_loop; }
+
+    // 把 func 交给指定分片的事件循环线程执行, 线程安全
+    // 和 pushEvent 一样只移动不拷贝, 只能移动的函数对象也行
+    template<typename Func>
+    void post(size_t shard, Func&& func) { postTask(shard, UniqueTask(std::forward<Func>(func))); }
+    // 轮流分配
+    template<typename Func>
+    void post(Func&& func) { postTask(next(), UniqueTask(std::forward<Func>(func))); }
+
+    size_t next() { return m_next.fetch_add(1, std::memory_order_relaxed) % m_shards.size(); }
+
+    // 按 key 的 hash 固定分到一个分片, 同一个连接 / 用户的事件总在同一个线程上
+    template<typename Key>
+    size_t shardOf(const Key& key) const { return std::hash<Key>()(key) % m_shards.size(); }
+
+    // 当前线程是这个 runtime 的第几个分片, 不是分片线程返回 NoShard
+    size_t currentShard() const;
+
+    // 让所有分片退出事件循环并等待线程结束, 还没执行的事件和 timer 都丢掉, 可以重复调用
+    void stop();
+};
+
+}
+
+#endif // BLXCPP_ASYNCRUNTIME_HPP
@@ -0,0 +1,73 @@
+// Clock.cpp
+#include "Clock.hpp"
+
+#include <chrono>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define BLXCPP_HAS_RDTSC 1
+#endif
+
+namespace blxcpp {
+
+namespace {
+
+#ifdef BLXCPP_HAS_RDTSC
+
+// TSC 和 steady_clock 的换算关系, 第一次用到的时候校准
+struct TscCalibration {
+    bool m_valid;
+    uint64_t m_base_tsc;
+    Clock::Time m_base;
+    double m_micros_per_tick;
+
+    TscCalibration()
+        : m_valid(false), m_base_tsc(0), m_base(0), m_micros_per_tick(0) {
+        // CPUID 0x80000007 EDX bit 8: invariant TSC, 不随频率变化, 深度睡眠也不停
+        unsigned eax, ebx, ecx, edx;
+        if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) || !(edx & (1u << 8))) return;
+
+        m_base = Clock::steady();
+        m_base_tsc = __rdtsc();
+        Clock::Time end = m_base;
+        while (end - m_base < 5000) end = Clock::steady();
+        uint64_t ticks = __rdtsc() - m_base_tsc;
+        if (ticks == 0) return;
+
+        m_micros_per_tick = double(end - m_base) / double(ticks);
+        m_valid = true;
+    }
+};
+
+const TscCalibration& calibration() {
+    static TscCalibration calibration;
+    return calibration;
+}
+
+#endif
+
+}
+
+Clock::Time Clock::steady() {
+    return std::chrono::duration_cast<std::chrono::microseconds>
+            (std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Clock::Time Clock::tsc() {
+#ifdef BLXCPP_HAS_RDTSC
+    const TscCalibration& c = calibration();
+    if (c.m_valid) return c.m_base + Time(double(__rdtsc() - c.m_base_tsc) * c.m_micros_per_tick);
+#endif
+    return steady();
+}
+
+bool Clock::hasTsc() {
+#ifdef BLXCPP_HAS_RDTSC
+    return calibration().m_valid;
+#else
+    return false;
+#endif
+}
+
+}
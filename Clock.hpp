@@ -0,0 +1,25 @@
+// Clock.hpp
+#ifndef BLXCPP_CLOCK_HPP
+#define BLXCPP_CLOCK_HPP
+
+#include <cstdint>
+
+namespace blxcpp {
+
+// 定时用的时钟, 单位都是微秒, 起点不固定, 只能拿来算时间差
+class Clock {
+public:
+    using Time = int64_t;
+
+    // steady_clock, 不受 NTP 和手动改系统时间的影响
+    static Time steady();
+
+    // 用 TSC 换算出来的时间, 比 steady 便宜, 只有 x86 并且 TSC 是 invariant 的时候才用
+    // 第一次调用时和 steady_clock 校准一次 (会忙等几毫秒), 不支持的话就是 steady()
+    static Time tsc();
+    static bool hasTsc();
+};
+
+}
+
+#endif // BLXCPP_CLOCK_HPP
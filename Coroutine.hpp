@@ -0,0 +1,203 @@
+// Coroutine.hpp
+#ifndef BLXCPP_COROUTINE_HPP
+#define BLXCPP_COROUTINE_HPP
+
+#include "Async.hpp"
+#include "Future.hpp"
+
+// 需要 C++20 协程, 低版本标准下这个头文件什么都不提供
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <exception>
+#include <utility>
+
+namespace blxcpp {
+
+// 协程都跑在事件循环线程上:
+//     co_await loop->async(func)(args...);  // 在线程池里执行, 回到事件循环线程拿结果
+//     co_await sleep(100);                  // 不阻塞线程, 100ms 后恢复
+//     co_await readable(fd);                // fd 可读了再恢复
+// Task.hpp 里已经有 Task 了, 所以协程类型叫 CoTask
+
+template <typename T = void>
+class CoTask;
+
+class CoPromiseBase {
+public:
+    std::coroutine_handle<> m_continuation;
+    std::exception_ptr m_error;
+    bool m_detached = false;
+
+    // 结束的时候直接切回等它的协程, 不经过事件队列
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+            CoPromiseBase& promise = handle.promise();
+            if (promise.m_continuation) return promise.m_continuation;
+            if (promise.m_detached) {
+                // 没人接的异常和 std::thread 一样直接结束进程, 不悄悄吞掉
+                if (promise.m_error) std::terminate();
+                handle.destroy();
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept { }
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { m_error = std::current_exception(); }
+};
+
+template <typename T>
+class CoPromise : public CoPromiseBase {
+public:
+    FutureValue<T> m_value;
+
+    template<typename U>
+    void return_value(U&& value) { m_value.set(std::forward<U>(value)); }
+
+    T take() {
+        if (m_error) std::rethrow_exception(m_error);
+        return m_value.take();
+    }
+};
+
+template <>
+class CoPromise<void> : public CoPromiseBase {
+public:
+    void return_void() { }
+
+    void take() {
+        if (m_error) std::rethrow_exception(m_error);
+    }
+};
+
+// 惰性的协程任务, 创建的时候不执行
+// 在另一个协程里 co_await 它才开始跑, 或者 start() 以后自己管理生命周期
+template <typename T>
+class CoTask {
+public:
+    class promise_type : public CoPromise<T> {
+    public:
+        CoTask get_return_object() {
+            return CoTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+    };
+
+    using Handle = std::coroutine_handle<promise_type>;
+
+private:
+    Handle m_handle;
+
+    explicit CoTask(Handle handle)
+        : m_handle(handle) { }
+
+public:
+    CoTask(CoTask&& other) noexcept
+        : m_handle(std::exchange(other.m_handle, nullptr)) { }
+
+    CoTask& operator=(CoTask&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) m_handle.destroy();
+            m_handle = std::exchange(other.m_handle, nullptr);
+        }
+        return *this;
+    }
+
+    CoTask(const CoTask&) = delete;
+    CoTask& operator=(const CoTask&) = delete;
+
+    ~CoTask() { if (m_handle) m_handle.destroy(); }
+
+    bool done() const { return !m_handle || m_handle.done(); }
+
+    // 在当前线程上开始执行, 执行完自己释放, 应该在事件循环线程上 (或者启动之前) 调用
+    void start() {
+        Handle handle = std::exchange(m_handle, nullptr);
+        handle.promise().m_detached = true;
+        handle.resume();
+    }
+
+    struct Awaiter {
+        Handle m_handle;
+
+        bool await_ready() const { return m_handle.done(); }
+
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation) {
+            m_handle.promise().m_continuation = continuation;
+            return m_handle;
+        }
+
+        T await_resume() { return m_handle.promise().take(); }
+    };
+
+    Awaiter operator co_await() && { return Awaiter{m_handle}; }
+};
+
+// 用 timer 挂起一段时间, 到期后在事件循环线程上恢复
+class SleepAwaiter {
+private:
+    AsyncEventLoop* m_event_loop;
+    Timer::Time m_time;
+
+public:
+    SleepAwaiter(AsyncEventLoop* event_loop, Timer::Time t)
+        : m_event_loop(event_loop), m_time(t) { }
+
+    bool await_ready() const { return false; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        m_event_loop->setTimeout(m_time, [handle](){ handle.resume(); });
+    }
+
+    void await_resume() { }
+};
+
+// 等 fd 可读 / 可写一次, 期间这个 fd 不能再被别的 watcher 占用
+// fd 不支持 epoll 的话不挂起, co_await 返回 false
+class FdAwaiter {
+private:
+    AsyncEventLoop* m_event_loop;
+    int m_fd;
+    bool m_write;
+    bool m_failed;
+
+public:
+    FdAwaiter(AsyncEventLoop* event_loop, int fd, bool write)
+        : m_event_loop(event_loop), m_fd(fd), m_write(write), m_failed(false) { }
+
+    bool await_ready() const { return false; }
+
+    bool await_suspend(std::coroutine_handle<> handle) {
+        AsyncEventLoop* event_loop = m_event_loop;
+        int fd = m_fd;
+        auto resume = [event_loop, fd, handle](){
+            event_loop->unwatch(fd);
+            handle.resume();
+        };
+        m_failed = !(m_write ? event_loop->watchWrite(fd, resume) : event_loop->watchRead(fd, resume));
+        return !m_failed;
+    }
+
+    bool await_resume() { return !m_failed; }
+};
+
+inline SleepAwaiter sleep(AsyncEventLoop* event_loop, Timer::Time t) { return SleepAwaiter(event_loop, t); }
+inline SleepAwaiter sleep(Timer::Time t) { return SleepAwaiter(AsyncEventLoop::getGlobal(), t); }
+
+inline FdAwaiter readable(AsyncEventLoop* event_loop, int fd) { return FdAwaiter(event_loop, fd, false); }
+inline FdAwaiter readable(int fd) { return FdAwaiter(AsyncEventLoop::getGlobal(), fd, false); }
+
+inline FdAwaiter writable(AsyncEventLoop* event_loop, int fd) { return FdAwaiter(event_loop, fd, true); }
+inline FdAwaiter writable(int fd) { return FdAwaiter(AsyncEventLoop::getGlobal(), fd, true); }
+
+}
+
+#endif
+
+#endif // BLXCPP_COROUTINE_HPP
@@ -0,0 +1,334 @@
+// Future.hpp
+#ifndef BLXCPP_FUTURE_HPP
+#define BLXCPP_FUTURE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <exception>
+#include <future>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <cstdint>
+#include <ctime>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "UniqueTask.hpp"
+#include "tuple_helper.hpp"
+
+namespace blxcpp {
+
+template <typename T>
+class Future;
+
+// 在一个 32 位状态字上等待, linux 下直接用 futex, 其他平台退化成 yield 轮询
+// 返回 false 表示超时
+struct FutureWaiter {
+    using Clock = std::chrono::steady_clock;
+
+    static bool wait(std::atomic<uint32_t>* word, uint32_t expected, const Clock::time_point* deadline) {
+#ifdef __linux__
+        struct timespec ts;
+        struct timespec* timeout = nullptr;
+        if (deadline != nullptr) {
+            Clock::duration left = *deadline - Clock::now();
+            if (left <= Clock::duration::zero()) return false;
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(left).count();
+            ts.tv_sec = static_cast<time_t>(ns / 1000000000);
+            ts.tv_nsec = static_cast<long>(ns % 1000000000);
+            timeout = &ts;
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+        return true;
+#else
+        (void) expected;
+        if (deadline != nullptr && Clock::now() >= *deadline) return false;
+        std::this_thread::yield();
+        return true;
+#endif
+    }
+
+    static void wakeAll(std::atomic<uint32_t>* word) {
+#ifdef __linux__
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(word), FUTEX_WAKE_PRIVATE, INT32_MAX, nullptr, nullptr, 0);
+#else
+        (void) word;
+#endif
+    }
+};
+
+// 结果的存储, void 单独特化
+template <typename T>
+class FutureValue {
+private:
+    typename std::aligned_storage<sizeof (T), alignof (T)>::type m_data;
+    bool m_has_value = false;
+
+public:
+    ~FutureValue() { if (m_has_value) reinterpret_cast<T*>(&m_data)->~T(); }
+
+    template<typename U>
+    void set(U&& value) {
+        new (&m_data) T(std::forward<U>(value));
+        m_has_value = true;
+    }
+
+    T take() { return std::move(*reinterpret_cast<T*>(&m_data)); }
+};
+
+template <>
+class FutureValue<void> {
+public:
+    void set() { }
+    void take() { }
+};
+
+// 共享状态: 一个原子状态字 + 内联存储的结果, 全程无锁
+// 生产者写完结果以后置 Ready, 消费者挂了 then 就置 Chained,
+// 谁后到谁负责执行 continuation
+template <typename T>
+class FutureState {
+public:
+    enum : uint32_t {
+        Ready   = 1 << 0,
+        Failed  = 1 << 1,
+        Chained = 1 << 2,
+        Waiting = 1 << 3,
+    };
+
+private:
+    std::atomic<uint32_t> m_state;
+    FutureValue<T> m_value;
+    std::exception_ptr m_error;
+    UniqueTask m_continuation;
+
+    void complete(uint32_t bits) {
+        uint32_t old = m_state.fetch_or(Ready | bits, std::memory_order_acq_rel);
+        if (old & Waiting) FutureWaiter::wakeAll(&m_state);
+        if (old & Chained) runContinuation();
+    }
+
+    void runContinuation() {
+        UniqueTask continuation = std::move(m_continuation);
+        continuation();
+    }
+
+public:
+    FutureState()
+        : m_state(0) { }
+
+    template<typename ...U>
+    void setValue(U&&... value) {
+        m_value.set(std::forward<U>(value)...);
+        complete(0);
+    }
+
+    void setError(std::exception_ptr error) {
+        m_error = error;
+        complete(Failed);
+    }
+
+    bool ready() const { return m_state.load(std::memory_order_acquire) & Ready; }
+
+    bool wait(const FutureWaiter::Clock::time_point* deadline) {
+        // 先稍微转几圈, 短任务大多数时候等不到 futex
+        for (int i = 0; i < 64; i++) {
+            if (ready()) return true;
+        }
+        while (true) {
+            uint32_t state = m_state.load(std::memory_order_acquire);
+            if (state & Ready) return true;
+            if (!(state & Waiting)) {
+                if (!m_state.compare_exchange_weak(state, state | Waiting,
+                        std::memory_order_acq_rel, std::memory_order_acquire)) continue;
+                state |= Waiting;
+            }
+            if (!FutureWaiter::wait(&m_state, state, deadline)) return ready();
+        }
+    }
+
+    T take() {
+        if (m_state.load(std::memory_order_acquire) & Failed) std::rethrow_exception(m_error);
+        return m_value.take();
+    }
+
+    std::exception_ptr error() const { return m_error; }
+    bool failed() const { return m_state.load(std::memory_order_acquire) & Failed; }
+
+    // 只能挂一次, 已经完成了就直接在当前线程执行
+    void onReady(UniqueTask&& continuation) {
+        m_continuation = std::move(continuation);
+        uint32_t old = m_state.fetch_or(Chained, std::memory_order_acq_rel);
+        if (old & Ready) runContinuation();
+    }
+};
+
+// 用 func 的结果去完成 state, 返回 void 的单独处理
+template <typename R>
+struct FutureResolver {
+    template<typename Func, typename ...Args>
+    static void resolve(FutureState<R>& state, Func& func, Args&&... args) {
+        state.setValue(func(std::forward<Args>(args)...));
+    }
+};
+
+template <>
+struct FutureResolver<void> {
+    template<typename Func, typename ...Args>
+    static void resolve(FutureState<void>& state, Func& func, Args&&... args) {
+        func(std::forward<Args>(args)...);
+        state.setValue();
+    }
+};
+
+// 投递到线程池里的任务本体: 保存函数和参数, 执行完以后完成 state
+// 没执行就被销毁的话, 以 broken_promise 结束, 不让等待的一方永远卡住
+template <typename R, typename Func, typename ...Args>
+class FutureTask {
+private:
+    std::shared_ptr<FutureState<R>> m_state;
+    Func m_func;
+    std::tuple<Args...> m_args;
+
+    template<int ...Indexes>
+    void invoke(IndexTuple<Indexes...>) {
+        FutureResolver<R>::resolve(*m_state, m_func, std::move(std::get<Indexes>(m_args))...);
+    }
+
+public:
+    template<typename F, typename ...A>
+    FutureTask(const std::shared_ptr<FutureState<R>>& state, F&& func, A&&... args)
+        : m_state(state)
+        , m_func(std::forward<F>(func))
+        , m_args(std::forward<A>(args)...) { }
+
+    FutureTask(FutureTask&&) = default;
+
+    ~FutureTask() {
+        if (m_state && !m_state->ready()) {
+            m_state->setError(std::make_exception_ptr(
+                std::future_error(std::future_errc::broken_promise)));
+        }
+    }
+
+    void operator()() {
+        try {
+            invoke(typename MakeIndexes<sizeof...(Args)>::type());
+        } catch (...) {
+            m_state->setError(std::current_exception());
+        }
+        m_state.reset();
+    }
+};
+
+// then 挂上去的 continuation, 拿前一个 state 的结果调用 func 去完成下一个 state
+// 前一个 state 只存裸指针, 它执行的时候前一个 state 一定还活着, 也避免循环引用
+template <typename T, typename R, typename Func>
+class FutureThen {
+private:
+    FutureState<T>* m_prev;
+    std::shared_ptr<FutureState<R>> m_next;
+    Func m_func;
+
+    template<typename U>
+    struct Tag { };
+
+    template<typename U>
+    void resolve(Tag<U>) { FutureResolver<R>::resolve(*m_next, m_func, m_prev->take()); }
+
+    void resolve(Tag<void>) { FutureResolver<R>::resolve(*m_next, m_func); }
+
+public:
+    template<typename F>
+    FutureThen(FutureState<T>* prev, const std::shared_ptr<FutureState<R>>& next, F&& func)
+        : m_prev(prev), m_next(next), m_func(std::forward<F>(func)) { }
+
+    void operator()() {
+        if (m_prev->failed()) {
+            m_next->setError(m_prev->error());
+            return;
+        }
+        try {
+            resolve(Tag<T>());
+        } catch (...) {
+            m_next->setError(std::current_exception());
+        }
+    }
+};
+
+template <typename T>
+class Future {
+public:
+    using State = FutureState<T>;
+
+private:
+    std::shared_ptr<State> m_state;
+
+    template<typename Func, typename U>
+    struct ThenResult { using type = typename std::result_of<Func(U)>::type; };
+
+    template<typename Func>
+    struct ThenResult<Func, void> { using type = typename std::result_of<Func()>::type; };
+
+    void check() const {
+        if (!m_state) throw std::future_error(std::future_errc::no_state);
+    }
+
+public:
+    Future() { }
+
+    explicit Future(const std::shared_ptr<State>& state)
+        : m_state(state) { }
+
+    Future(Future&&) = default;
+    Future& operator=(Future&&) = default;
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    bool valid() const { return m_state != nullptr; }
+    bool ready() const { check(); return m_state->ready(); }
+
+    void wait() const {
+        check();
+        m_state->wait(nullptr);
+    }
+
+    template<typename Rep, typename Period>
+    bool wait_for(const std::chrono::duration<Rep, Period>& timeout) const {
+        check();
+        auto deadline = FutureWaiter::Clock::now()
+                + std::chrono::duration_cast<FutureWaiter::Clock::duration>(timeout);
+        return m_state->wait(&deadline);
+    }
+
+    // 阻塞拿结果, 只能拿一次, 任务里抛出的异常会在这里重新抛出
+    T get() {
+        wait();
+        std::shared_ptr<State> state = std::move(m_state);
+        return state->take();
+    }
+
+    // continuation 在完成 state 的那个线程上直接执行 (已经完成的话就是当前线程)
+    // 所以里面只适合放轻量的逻辑, 重活请再 put 回线程池
+    template<typename Func>
+    auto then(Func&& func) -> Future<typename ThenResult<typename std::decay<Func>::type, T>::type> {
+        check();
+        using R = typename ThenResult<typename std::decay<Func>::type, T>::type;
+        auto next = std::make_shared<FutureState<R>>();
+        std::shared_ptr<State> state = std::move(m_state);
+        state->onReady(FutureThen<T, R, typename std::decay<Func>::type>(
+                           state.get(), next, std::forward<Func>(func)));
+        return Future<R>(next);
+    }
+};
+
+}
+
+#endif // BLXCPP_FUTURE_HPP
@@ -0,0 +1,175 @@
+// IoUring.cpp
+#include "IoUring.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#if BLXCPP_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace blxcpp {
+
+#if BLXCPP_IO_URING
+
+namespace {
+
+template <typename T>
+T* offset(void* base, uint32_t off) {
+    return reinterpret_cast<T*>(static_cast<char*>(base) + off);
+}
+
+unsigned loadAcquire(unsigned* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+void storeRelease(unsigned* p, unsigned v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+
+}
+
+IoUring::IoUring(unsigned entries)
+    : m_fd(-1)
+    , m_sq_ring(MAP_FAILED), m_sq_ring_size(0)
+    , m_cq_ring(MAP_FAILED), m_cq_ring_size(0)
+    , m_sqes(MAP_FAILED), m_sqes_size(0)
+    , m_sq_head(nullptr), m_sq_tail(nullptr), m_sq_array(nullptr), m_sq_mask(0), m_sq_entries(0)
+    , m_cq_head(nullptr), m_cq_tail(nullptr), m_cqes(nullptr), m_cq_mask(0)
+    , m_local_tail(0), m_unsubmitted(0) {
+
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof (params));
+    int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd < 0) return;
+
+    m_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    m_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof (struct io_uring_cqe);
+    bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single) m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+
+    m_sq_ring = mmap(nullptr, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (m_sq_ring == MAP_FAILED) { close(fd); return; }
+
+    if (single) {
+        m_cq_ring = m_sq_ring;
+    } else {
+        m_cq_ring = mmap(nullptr, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (m_cq_ring == MAP_FAILED) { munmap(m_sq_ring, m_sq_ring_size); close(fd); return; }
+    }
+
+    m_sqes_size = params.sq_entries * sizeof (struct io_uring_sqe);
+    m_sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED) {
+        if (!single) munmap(m_cq_ring, m_cq_ring_size);
+        munmap(m_sq_ring, m_sq_ring_size);
+        close(fd);
+        return;
+    }
+
+    m_sq_head = offset<unsigned>(m_sq_ring, params.sq_off.head);
+    m_sq_tail = offset<unsigned>(m_sq_ring, params.sq_off.tail);
+    m_sq_array = offset<unsigned>(m_sq_ring, params.sq_off.array);
+    m_sq_mask = *offset<unsigned>(m_sq_ring, params.sq_off.ring_mask);
+    m_sq_entries = *offset<unsigned>(m_sq_ring, params.sq_off.ring_entries);
+
+    m_cq_head = offset<unsigned>(m_cq_ring, params.cq_off.head);
+    m_cq_tail = offset<unsigned>(m_cq_ring, params.cq_off.tail);
+    m_cqes = offset<void>(m_cq_ring, params.cq_off.cqes);
+    m_cq_mask = *offset<unsigned>(m_cq_ring, params.cq_off.ring_mask);
+
+    m_local_tail = *m_sq_tail;
+    m_fd = fd;
+}
+
+IoUring::~IoUring() {
+    if (m_fd < 0) return;
+    munmap(m_sqes, m_sqes_size);
+    if (m_cq_ring != m_sq_ring) munmap(m_cq_ring, m_cq_ring_size);
+    munmap(m_sq_ring, m_sq_ring_size);
+    close(m_fd);
+}
+
+bool IoUring::prepare(Op op, int fd, void* buf, size_t len, int64_t offset, uint64_t user_data) {
+    if (m_fd < 0) return false;
+    if (m_local_tail - loadAcquire(m_sq_head) >= m_sq_entries) return false;
+
+    unsigned index = m_local_tail & m_sq_mask;
+    struct io_uring_sqe* sqe = static_cast<struct io_uring_sqe*>(m_sqes) + index;
+    std::memset(sqe, 0, sizeof (*sqe));
+    sqe->fd = fd;
+    sqe->user_data = user_data;
+
+    switch (op) {
+    case Read:
+    case Write:
+        sqe->opcode = op == Read ? IORING_OP_READ : IORING_OP_WRITE;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        sqe->len = static_cast<uint32_t>(std::min<size_t>(len, UINT32_MAX));
+        sqe->off = static_cast<uint64_t>(offset);
+        break;
+    case Accept:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->accept_flags = SOCK_CLOEXEC;
+        break;
+    case Cancel:
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = reinterpret_cast<uint64_t>(buf);
+        break;
+    }
+
+    m_sq_array[index] = index;
+    m_local_tail++;
+    return true;
+}
+
+int IoUring::submit(unsigned wait) {
+    if (m_fd < 0) return -EINVAL;
+
+    unsigned tail = *m_sq_tail;
+    m_unsubmitted += m_local_tail - tail;
+    storeRelease(m_sq_tail, m_local_tail);
+    if (m_unsubmitted == 0 && wait == 0) return 0;
+
+    unsigned flags = wait > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int submitted = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, m_unsubmitted, wait, flags, nullptr, 0));
+    if (submitted < 0) return -errno;
+    m_unsubmitted -= std::min<unsigned>(m_unsubmitted, static_cast<unsigned>(submitted));
+    return submitted;
+}
+
+bool IoUring::pop(uint64_t& user_data, int& res) {
+    if (m_fd < 0) return false;
+    unsigned head = *m_cq_head;
+    if (head == loadAcquire(m_cq_tail)) return false;
+
+    const struct io_uring_cqe* cqe = static_cast<const struct io_uring_cqe*>(m_cqes) + (head & m_cq_mask);
+    user_data = cqe->user_data;
+    res = cqe->res;
+    storeRelease(m_cq_head, head + 1);
+    return true;
+}
+
+#else
+
+IoUring::IoUring(unsigned)
+    : m_fd(-1)
+    , m_sq_ring(nullptr), m_sq_ring_size(0)
+    , m_cq_ring(nullptr), m_cq_ring_size(0)
+    , m_sqes(nullptr), m_sqes_size(0)
+    , m_sq_head(nullptr), m_sq_tail(nullptr), m_sq_array(nullptr), m_sq_mask(0), m_sq_entries(0)
+    , m_cq_head(nullptr), m_cq_tail(nullptr), m_cqes(nullptr), m_cq_mask(0)
+    , m_local_tail(0), m_unsubmitted(0) { }
+
+IoUring::~IoUring() { }
+
+bool IoUring::prepare(Op, int, void*, size_t, int64_t, uint64_t) { return false; }
+
+int IoUring::submit(unsigned) { return -ENOSYS; }
+
+bool IoUring::pop(uint64_t&, int&) { return false; }
+
+#endif
+
+}
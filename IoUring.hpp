@@ -0,0 +1,83 @@
+// IoUring.hpp
+#ifndef BLXCPP_IOURING_HPP
+#define BLXCPP_IOURING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+// 编译期开关, 默认在有 <linux/io_uring.h> 的 linux 上打开
+// 关闭或者运行时内核不支持的时候 valid() 返回 false, 使用者自己退化成别的方式
+#ifndef BLXCPP_IO_URING
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define BLXCPP_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifndef BLXCPP_IO_URING
+#define BLXCPP_IO_URING 0
+#endif
+
+namespace blxcpp {
+
+// 不依赖 liburing, 直接用系统调用和 mmap 出来的环形队列
+// 只能在一个线程上使用: prepare 只是写进提交队列, submit 才一次性交给内核
+class IoUring {
+public:
+    enum Op {
+        Read,
+        Write,
+        Accept,
+        Cancel, // 取消一个还没完成的请求, buf 是它的 user_data, 被取消的请求会以 -ECANCELED 完成
+    };
+
+private:
+    int m_fd;
+    void* m_sq_ring;
+    size_t m_sq_ring_size;
+    void* m_cq_ring;
+    size_t m_cq_ring_size;
+    void* m_sqes;
+    size_t m_sqes_size;
+
+    unsigned* m_sq_head;
+    unsigned* m_sq_tail;
+    unsigned* m_sq_array;
+    unsigned m_sq_mask;
+    unsigned m_sq_entries;
+
+    unsigned* m_cq_head;
+    unsigned* m_cq_tail;
+    void* m_cqes;
+    unsigned m_cq_mask;
+
+    unsigned m_local_tail;  // 已经写好但还没发布给内核的 tail
+    unsigned m_unsubmitted; // 已经发布但内核还没接收的个数
+
+public:
+    explicit IoUring(unsigned entries = 256);
+    ~IoUring();
+
+    IoUring(const IoUring&) = delete;
+    IoUring& operator=(const IoUring&) = delete;
+
+    bool valid() const { return m_fd >= 0; }
+
+    // 有完成事件的时候可读, 可以放进 epoll 里等
+    int fd() const { return m_fd; }
+
+    // offset 为 -1 表示用 fd 当前的位置, Accept 忽略 buf / len / offset
+    // 提交队列满了返回 false
+    bool prepare(Op op, int fd, void* buf, size_t len, int64_t offset, uint64_t user_data);
+
+    // 把准备好的请求交给内核, wait 大于 0 时至少等到这么多个完成
+    int submit(unsigned wait = 0);
+
+    // 取出一个已经完成的请求, res >= 0 是结果, < 0 是 -errno
+    bool pop(uint64_t& user_data, int& res);
+};
+
+}
+
+#endif // BLXCPP_IOURING_HPP
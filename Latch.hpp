@@ -0,0 +1,49 @@
+// Latch.hpp
+#ifndef BLXCPP_LATCH_HPP
+#define BLXCPP_LATCH_HPP
+
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+namespace blxcpp {
+
+// 倒计数门闩, 和 std::latch 不同的是计数可以在中途 add
+// (拆分出来的子任务数事先不知道), 计数归零的时候才去碰锁和条件变量
+// 归零以后不能再 add, 计数必须在还没归零之前加上去
+class Latch {
+private:
+    std::atomic<int64_t> m_count;
+    std::mutex m_lock;
+    std::condition_variable m_zero;
+    bool m_done; // 在锁里置位, 保证 wait 返回 (可能马上析构) 的时候 count_down 已经不再碰这个对象
+
+public:
+    explicit Latch(int64_t count)
+        : m_count(count), m_done(count == 0) { }
+
+    Latch(const Latch&) = delete;
+    Latch& operator=(const Latch&) = delete;
+
+    void add(int64_t n = 1) { m_count.fetch_add(n, std::memory_order_relaxed); }
+
+    void count_down(int64_t n = 1) {
+        if (m_count.fetch_sub(n, std::memory_order_acq_rel) == n) {
+            std::lock_guard<std::mutex> sp(m_lock);
+            m_done = true;
+            m_zero.notify_all();
+        }
+    }
+
+    bool try_wait() const { return m_count.load(std::memory_order_acquire) == 0; }
+
+    void wait() {
+        std::unique_lock<std::mutex> locker(m_lock);
+        m_zero.wait(locker, [this](){ return m_done; });
+    }
+};
+
+}
+
+#endif // BLXCPP_LATCH_HPP
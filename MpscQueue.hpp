@@ -0,0 +1,88 @@
+// MpscQueue.hpp
+#ifndef BLXCPP_MPSCQUEUE_HPP
+#define BLXCPP_MPSCQUEUE_HPP
+
+#include <atomic>
+
+namespace blxcpp {
+
+// 侵入式链表节点, 放进 MpscQueue 的元素要继承它
+struct MpscNode {
+    std::atomic<MpscNode*> m_next;
+
+    MpscNode()
+        : m_next(nullptr) { }
+};
+
+// Dmitry Vyukov 的侵入式多生产者单消费者队列
+// push 任意线程都可以调用, 只有一次 exchange, 不会和消费者抢锁
+// pop / empty 只能在唯一的消费者线程上调用
+// 队列不管元素的内存, pop 出来的节点由调用者负责释放
+template <typename T>
+class MpscQueue {
+private:
+    std::atomic<MpscNode*> m_head; // 生产者在这里 exchange
+    MpscNode* m_tail;              // 消费者从这里取
+    MpscNode m_stub;
+
+    void pushNode(MpscNode* node) {
+        node->m_next.store(nullptr, std::memory_order_relaxed);
+        MpscNode* prev = m_head.exchange(node, std::memory_order_acq_rel);
+        prev->m_next.store(node, std::memory_order_release);
+    }
+
+public:
+    MpscQueue()
+        : m_head(&m_stub), m_tail(&m_stub) { }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        while (T* node = pop()) delete node;
+    }
+
+    void push(T* node) { pushNode(node); }
+
+    // 空的时候返回 nullptr
+    // 生产者 exchange 完还没来得及链上 next 的那一瞬间也会返回 nullptr,
+    // 这时 empty() 仍然是 false, 调用者稍后再取就行
+    T* pop() {
+        MpscNode* tail = m_tail;
+        MpscNode* next = tail->m_next.load(std::memory_order_acquire);
+
+        if (tail == &m_stub) {
+            if (next == nullptr) return nullptr;
+            m_tail = next;
+            tail = next;
+            next = next->m_next.load(std::memory_order_acquire);
+        }
+
+        if (next != nullptr) {
+            m_tail = next;
+            return static_cast<T*>(tail);
+        }
+
+        if (tail != m_head.load(std::memory_order_acquire)) return nullptr;
+
+        // 只剩最后一个了, 把 stub 放回去才能把它取出来
+        pushNode(&m_stub);
+        next = tail->m_next.load(std::memory_order_acquire);
+        if (next != nullptr) {
+            m_tail = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+
+    // 保守的判断: 有生产者正在 push 的时候返回 false
+    bool empty() const {
+        MpscNode* tail = m_tail;
+        return tail->m_next.load(std::memory_order_acquire) == nullptr
+                && m_head.load(std::memory_order_acquire) == tail;
+    }
+};
+
+}
+
+#endif // BLXCPP_MPSCQUEUE_HPP
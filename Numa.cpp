@@ -0,0 +1,99 @@
+// Numa.cpp
+#include "Numa.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+#include <cstdlib>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#endif
+
+namespace blxcpp {
+
+std::vector<int> Numa::parseCpuList(const std::string &list) {
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string range;
+    while (std::getline(stream, range, ',')) {
+        if (range.empty() || range[0] == '\n') continue;
+        size_t dash = range.find('-');
+        int first = std::atoi(range.substr(0, dash).c_str());
+        int last = dash == std::string::npos ? first : std::atoi(range.substr(dash + 1).c_str());
+        for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::vector<Numa::Node> Numa::nodes() {
+    std::vector<Node> nodes;
+
+#ifdef __linux__
+    const std::string root = "/sys/devices/system/node/";
+    if (DIR* dir = opendir(root.c_str())) {
+        while (struct dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name.compare(0, 4, "node") != 0 || name.size() == 4
+                    || name.find_first_not_of("0123456789", 4) != std::string::npos) continue;
+
+            std::ifstream file(root + name + "/cpulist");
+            std::string list;
+            if (!std::getline(file, list)) continue;
+
+            Node node;
+            node.m_id = std::atoi(name.c_str() + 4);
+            node.m_cpus = parseCpuList(list);
+            // 只有内存没有 CPU 的 node 放不了 worker
+            if (!node.m_cpus.empty()) nodes.push_back(node);
+        }
+        closedir(dir);
+    }
+#endif
+
+    if (nodes.empty()) {
+        Node node;
+        node.m_id = 0;
+        unsigned count = std::max(std::thread::hardware_concurrency(), 1u);
+        for (unsigned cpu = 0; cpu < count; cpu++) node.m_cpus.push_back(static_cast<int>(cpu));
+        nodes.push_back(node);
+    }
+
+    std::sort(nodes.begin(), nodes.end(), [](const Node& l, const Node& r){ return l.m_id < r.m_id; });
+    return nodes;
+}
+
+bool Numa::pinCurrent(const std::vector<int> &cpus) {
+#ifdef __linux__
+    if (cpus.empty()) return false;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void) cpus;
+    return false;
+#endif
+}
+
+bool Numa::preferNode(int node) {
+#ifdef __linux__
+    // 直接走系统调用, 不依赖 libnuma
+    if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8)) return false;
+    unsigned long mask = 1UL << node;
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, &mask, sizeof(mask) * 8) == 0;
+#else
+    (void) node;
+    return false;
+#endif
+}
+
+}
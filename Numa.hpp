@@ -0,0 +1,34 @@
+// Numa.hpp
+#ifndef BLXCPP_NUMA_HPP
+#define BLXCPP_NUMA_HPP
+
+#include <string>
+#include <vector>
+
+namespace blxcpp {
+
+// CPU 亲和性和 NUMA 拓扑的一点点封装, 只有 linux 下是真的起作用的
+// 其他平台上只有一个 node, pin 什么都不做
+class Numa {
+public:
+    struct Node {
+        int m_id;
+        std::vector<int> m_cpus;
+    };
+
+    // 从 /sys/devices/system/node 读出来的拓扑, 读不到的话当成只有一个 node
+    static std::vector<Node> nodes();
+
+    // 解析 "0-3,8,10-11" 这样的 cpulist
+    static std::vector<int> parseCpuList(const std::string& list);
+
+    // 把当前线程绑到这些 CPU 上
+    static bool pinCurrent(const std::vector<int>& cpus);
+
+    // 当前线程之后分配的内存优先放在这个 node 上
+    static bool preferNode(int node);
+};
+
+}
+
+#endif // BLXCPP_NUMA_HPP
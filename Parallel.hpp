@@ -0,0 +1,136 @@
+// Parallel.hpp
+#ifndef BLXCPP_PARALLEL_HPP
+#define BLXCPP_PARALLEL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+#include "Latch.hpp"
+#include "ThreadPool.hpp"
+
+namespace blxcpp {
+
+// 一段 [begin, end) 区间, Index 可以是整数也可以是随机访问迭代器
+// grain 是不再继续拆分的最小块大小
+template <typename Index>
+struct Range {
+    Index begin;
+    Index end;
+    size_t grain;
+};
+
+template <typename Index>
+Range<Index> range(Index begin, Index end, size_t grain = 1) {
+    return Range<Index>{ begin, end, grain };
+}
+
+// parallel_for / parallel_reduce 共用的拆分逻辑
+// 每次对半拆, 上半段丢进线程池, 下半段自己接着做, 所以调用线程也在干活
+// 先无条件拆几层让每个 worker 都有活, 之后只有线程池里有人闲着才继续拆
+// 完成靠 Latch 计数, 不去轮询 ThreadPool::busy()
+// 上半段用 try_put 投, 不会被 DropOldest 丢掉; 队列满了投不进去就自己接着做, 不拆了
+//
+// 注意: 调用线程会阻塞等全部子任务完成, 不要在只有一个 worker 的池子的任务里调用
+template <typename Index, typename Leaf>
+class ParallelSplitter {
+private:
+    ThreadPool& m_pool;
+    Leaf& m_leaf;
+    size_t m_grain;
+    Latch m_latch;
+    std::atomic<bool> m_failed;
+    std::exception_ptr m_error;
+
+    void fail() {
+        bool expected = false;
+        if (m_failed.compare_exchange_strong(expected, true)) {
+            m_error = std::current_exception();
+        }
+    }
+
+public:
+    ParallelSplitter(ThreadPool& pool, Leaf& leaf, size_t grain)
+        : m_pool(pool), m_leaf(leaf), m_grain(std::max<size_t>(grain, 1)), m_latch(1), m_failed(false) { }
+
+    void split(Index begin, Index end, int depth) {
+        try {
+            while (static_cast<size_t>(end - begin) > m_grain && (depth > 0 || m_pool.idle() > 0)) {
+                Index middle = begin + (end - begin) / 2;
+                int next = depth - 1;
+                m_latch.add(1);
+                bool queued = m_pool.try_put([this, middle, end, next](){
+                    split(middle, end, next);
+                    m_latch.count_down();
+                });
+                if (!queued) {
+                    m_latch.count_down();
+                    break;
+                }
+                end = middle;
+                depth = next;
+            }
+            if (!m_failed.load(std::memory_order_relaxed)) m_leaf(begin, end);
+        } catch (...) {
+            fail();
+        }
+    }
+
+    void run(Index begin, Index end) {
+        if (!(begin < end)) return;
+
+        // 初始拆分深度: 大约切成 4 倍 worker 数的块
+        int depth = 2;
+        for (size_t n = m_pool.size(); n > 1; n >>= 1) depth++;
+
+        // 计数的初始 1 是调用线程自己那一份
+        split(begin, end, depth);
+        m_latch.count_down();
+        m_latch.wait();
+        if (m_error) std::rethrow_exception(m_error);
+    }
+};
+
+// 对 [begin, end) 里的每个 i 调用 func(i)
+template <typename Index, typename Func>
+void parallel_for(ThreadPool& pool, Index begin, Index end, size_t grain, const Func& func) {
+    auto leaf = [&func](Index b, Index e){
+        for (Index i = b; i != e; ++i) func(i);
+    };
+    ParallelSplitter<Index, decltype(leaf)> splitter(pool, leaf, grain);
+    splitter.run(begin, end);
+}
+
+// 每块从 identity 开始用 combine(acc, map(i)) 归约
+// 最后按区间顺序把各块的结果再 combine 起来, 所以 combine 满足结合律就行, 不要求交换律
+template <typename Index, typename T, typename Map, typename Combine>
+T parallel_reduce(ThreadPool& pool, const Range<Index>& range, const T& identity, const Map& map, const Combine& combine) {
+    std::mutex lock;
+    std::vector<std::pair<Index, T>> partials;
+
+    auto leaf = [&](Index b, Index e){
+        T acc = identity;
+        for (Index i = b; i != e; ++i) acc = combine(std::move(acc), map(i));
+        std::lock_guard<std::mutex> sp(lock);
+        partials.emplace_back(b, std::move(acc));
+    };
+    ParallelSplitter<Index, decltype(leaf)> splitter(pool, leaf, range.grain);
+    splitter.run(range.begin, range.end);
+
+    std::sort(partials.begin(), partials.end(),
+              [](const std::pair<Index, T>& l, const std::pair<Index, T>& r){ return l.first < r.first; });
+
+    T result = identity;
+    for (std::pair<Index, T>& partial : partials) {
+        result = combine(std::move(result), std::move(partial.second));
+    }
+    return result;
+}
+
+}
+
+#endif // BLXCPP_PARALLEL_HPP
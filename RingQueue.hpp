@@ -0,0 +1,73 @@
+// RingQueue.hpp
+#ifndef BLXCPP_RINGQUEUE_HPP
+#define BLXCPP_RINGQUEUE_HPP
+
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace blxcpp {
+
+// 不加锁的 FIFO 环形队列, 调用者自己负责同步
+// 满了容量翻倍, 之后一直留着不缩, 所以长度稳定以后 push / pop 都不碰分配器
+// 槽里的元素出队以后被移走留在原地, 下次入队时直接赋值覆盖
+template <typename T>
+class RingQueue {
+private:
+    std::vector<T> m_data;
+    size_t m_head;
+    size_t m_size;
+
+    T& at(size_t i) { return m_data[(m_head + i) & (m_data.size() - 1)]; }
+
+    void grow() {
+        std::vector<T> data(m_data.empty() ? 16 : m_data.size() * 2);
+        for (size_t i = 0; i < m_size; i++) data[i] = std::move(at(i));
+        m_data.swap(data);
+        m_head = 0;
+    }
+
+public:
+    RingQueue()
+        : m_head(0), m_size(0) { }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    bool empty() const { return m_size == 0; }
+    size_t size() const { return m_size; }
+    size_t capacity() const { return m_data.size(); }
+
+    // 预先留出至少 n 个槽
+    void reserve(size_t n) {
+        while (m_data.size() < n) grow();
+    }
+
+    void push_back(T&& value) {
+        if (m_size == m_data.size()) grow();
+        at(m_size) = std::move(value);
+        m_size++;
+    }
+
+    T& front() { return at(0); }
+    T& operator[](size_t i) { return at(i); }
+
+    void pop_front() {
+        at(0) = T(); // 别让已经取走的元素一直占着资源
+        m_head = (m_head + 1) & (m_data.size() - 1);
+        m_size--;
+    }
+
+    // 把第 i 个移走, 后面的往前挪一格, 保持顺序
+    T take(size_t i) {
+        T value(std::move(at(i)));
+        for (; i + 1 < m_size; i++) at(i) = std::move(at(i + 1));
+        at(m_size - 1) = T();
+        m_size--;
+        return value;
+    }
+};
+
+}
+
+#endif // BLXCPP_RINGQUEUE_HPP
@@ -0,0 +1,82 @@
+// SpscQueue.hpp
+#ifndef BLXCPP_SPSCQUEUE_HPP
+#define BLXCPP_SPSCQUEUE_HPP
+
+#include <atomic>
+#include <utility>
+#include <vector>
+#include <cstddef>
+
+namespace blxcpp {
+
+// 定长的单生产者单消费者环形队列
+// 头尾各自缓存对方的下标, 大多数时候生产者和消费者都只碰自己那一条缓存行
+template <typename T>
+class SpscQueue {
+private:
+    static const size_t CacheLine = 64;
+
+    std::vector<T> m_data;
+    const size_t m_mask;
+
+    char m_pad0[CacheLine];
+    std::atomic<size_t> m_head; // 消费者写
+    size_t m_cached_tail;
+    char m_pad1[CacheLine];
+    std::atomic<size_t> m_tail; // 生产者写
+    size_t m_cached_head;
+    char m_pad2[CacheLine];
+
+    static size_t roundUp(size_t n) {
+        size_t capacity = 2;
+        while (capacity < n) capacity <<= 1;
+        return capacity;
+    }
+
+public:
+    // 容量向上取到 2 的幂
+    explicit SpscQueue(size_t capacity = 1024)
+        : m_data(roundUp(capacity))
+        , m_mask(m_data.size() - 1)
+        , m_head(0), m_cached_tail(0)
+        , m_tail(0), m_cached_head(0) { }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 只能在生产者线程上调用, 满了返回 false
+    template<typename U>
+    bool push(U&& value) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cached_head == m_data.size()) {
+            m_cached_head = m_head.load(std::memory_order_acquire);
+            if (tail - m_cached_head == m_data.size()) return false;
+        }
+        m_data[tail & m_mask] = std::forward<U>(value);
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 只能在消费者线程上调用, 空了返回 false
+    bool pop(T& value) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cached_tail) {
+            m_cached_tail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cached_tail) return false;
+        }
+        value = std::move(m_data[head & m_mask]);
+        m_data[head & m_mask] = T(); // 别让已经取走的元素一直占着资源
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    size_t capacity() const { return m_data.size(); }
+};
+
+}
+
+#endif // BLXCPP_SPSCQUEUE_HPP
@@ -1,70 +1,598 @@
 // ThreadPool.cpp
 #include "ThreadPool.hpp"
+#include "Numa.hpp"
+
+#include <algorithm>
 
 namespace blxcpp {
 
-void ThreadPool::run(ThreadPool::Pool *pool) {
+thread_local ThreadPool::Worker* ThreadPool::current = nullptr;
+
+void ThreadPool::run(ThreadPool::Pool *pool, ThreadPool::Worker *worker) {
+    current = worker;
+
+    // 绑核 + 内存优先从本 node 分配, 配合 linux 默认的 first-touch, 任务里分配的内存会留在本地
+    if (!worker->m_cpus.empty()) Numa::pinCurrent(worker->m_cpus);
+    if (pool->m_nodes.size() > 1) Numa::preferNode(pool->m_nodes[worker->m_node].m_id);
+
+    if (pool->m_mode == Mode::WorkStealing) {
+        pool->runStealing(worker);
+    } else {
+        pool->runShared(worker);
+    }
+    current = nullptr;
+}
+
+template<typename Pred>
+bool ThreadPool::sleep(std::unique_lock<std::mutex> &locker, ThreadPool::Worker *worker, Pred ready) {
+    // 先登记再检查条件, 和 put 那边先入队再看 m_sleeping_threads 配对
+    // 这样就不会漏掉唤醒
+    m_sleeping_threads++;
+    while (!ready()) {
+        if (!elastic()) {
+            m_queue_not_empty.wait(locker);
+            continue;
+        }
+
+        // 弹性模式下闲太久就退出, 但至少留 min_threads 个
+        if (m_queue_not_empty.wait_for(locker, m_idle_timeout) == std::cv_status::timeout
+                && !ready() && m_live_threads > m_min_threads) {
+            m_sleeping_threads--;
+            worker->m_active = false;
+            m_live_threads--;
+            m_retirements.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    m_sleeping_threads--;
+    return true;
+}
+
+void ThreadPool::runShared(ThreadPool::Worker *worker) {
     while(true){
 
-        TaskS task;
+        Item item;
+        bool low = false;
         {
-            std::unique_lock<std::mutex> locker(pool->m_queue_lock);
-            pool->m_queue_not_empty.wait(locker, [pool](){
-                return !pool->m_task_queue.empty();
+            std::unique_lock<std::mutex> locker(m_queue_lock);
+            bool alive = sleep(locker, worker, [this](){
+                return m_queued > 0 || m_stop;
             });
-            task = pool->m_task_queue.front();
-            pool->m_task_queue.pop();
+            if (!alive) break;
+
+            // 停下来之前要先把队列里剩下的跑完
+            if (!dequeue(item, worker->m_node)) break;
+            low = crossedLow();
+        }
+        if (low) m_on_watermark(false);
+
+        execute(item, worker);
+    }
+}
 
-            // 获取到 task 了以后就要立即把线程设置为 busy 了
-            // 防止出现蛋疼的时间差
-            pool->m_busy_threads++;
+void ThreadPool::runStealing(ThreadPool::Worker *worker) {
+    while (true) {
+
+        Item item;
+        if (!take(worker, item)) {
+            std::unique_lock<std::mutex> locker(m_queue_lock);
+            // 什么都拿不到并且已经要停了, 自己的队列肯定是空的, 可以走了
+            // 别人队列里剩下的由别人自己跑完
+            if (m_stop && m_queued == 0) break;
+
+            bool alive = sleep(locker, worker, [this](){
+                return m_queued > 0 || m_local_pending > 0 || m_stop;
+            });
+            if (!alive) break;
+            continue;
         }
 
-        bool signal = task();
+        execute(item, worker);
+    }
+}
+
+bool ThreadPool::take(ThreadPool::Worker *worker, ThreadPool::Item &item) {
+    // 1. 自己的队列
+    if (LocalItem* local = worker->m_deque.pop()) {
+        m_local_pending--;
+        worker->m_local_hits.fetch_add(1, std::memory_order_relaxed);
+        item = std::move(local->m_item);
+        release(worker, local);
+        return true;
+    }
+
+    // 2. 共享的注入队列
+    bool found = false;
+    bool low = false;
+    {
+        std::lock_guard<std::mutex> sp(m_queue_lock);
+        found = dequeue(item, worker->m_node);
+        if (found) low = crossedLow();
+    }
+    if (low) m_on_watermark(false);
+    if (found) return true;
+
+    // 3. 从别的 worker 那里偷, 从下一个开始轮一圈, 避免大家都去偷同一个
+    //    先偷同一个 node 上的, 实在没有再跨 node
+    size_t size = m_workers.size();
+    for (int pass = 0; pass < 2; pass++)
+    for (size_t i = 1; i < size; i++) {
+        Worker* victim = m_workers[(worker->m_index + i) % size].get();
+        if ((victim->m_node == worker->m_node) != (pass == 0)) continue;
+        if (LocalItem* stolen = victim->m_deque.steal()) {
+            m_local_pending--;
+            worker->m_steals.fetch_add(1, std::memory_order_relaxed);
+            item = std::move(stolen->m_item);
+            release(worker, stolen);
+            return true;
+        }
+    }
 
-        // 执行完后再把线程设为 free
-        pool->m_busy_threads--;
+    return false;
+}
 
-        if (!signal) break;
+void ThreadPool::pushLocal(ThreadPool::Worker *worker, UniqueTask &&task, Priority priority, Clock::time_point deadline) {
+    // 先用自己的空闲节点, 没有了再把别人还回来的收一下, 都没有才分配
+    if (worker->m_free.empty()) {
+        while (LocalItem* node = worker->m_returned.pop()) worker->m_free.push_back(node);
     }
+    LocalItem* node;
+    if (worker->m_free.empty()) {
+        node = new LocalItem(worker);
+        // 空闲列表要装得下自己所有的节点, 趁着本来就在分配的时候扩, 之后还节点不会再分配
+        if (worker->m_free.capacity() < ++worker->m_owned) worker->m_free.reserve(worker->m_owned * 2);
+    } else {
+        node = worker->m_free.back();
+        worker->m_free.pop_back();
+    }
+    node->m_item = Item(std::move(task), priority, deadline);
+    worker->m_deque.push(node);
+}
+
+void ThreadPool::release(ThreadPool::Worker *worker, ThreadPool::LocalItem *node) {
+    if (node->m_owner == worker) worker->m_free.push_back(node);
+    else node->m_owner->m_returned.push(node);
 }
 
-ThreadPool::TaskS ThreadPool::create(const ThreadPool::Task &task, bool signal) {
-    return [=]{ task(); return signal; };
+void ThreadPool::execute(ThreadPool::Item &item, ThreadPool::Worker *worker) {
+    ThreadPoolStats::Stamp started = m_stats.started(item);
+    if (item.m_deadline != Clock::time_point::max() && item.m_deadline < Clock::now()) {
+        // 过期了就不跑了, 直接销毁 (submit 出来的 Future 会得到 broken_promise)
+        m_expired.fetch_add(1, std::memory_order_relaxed);
+        item.m_task = UniqueTask();
+        if (m_on_expired) m_on_expired(item.m_priority);
+    } else {
+        item.m_task();
+    }
+    m_stats.finished(worker->m_index, started);
+    finish();
+}
+
+void ThreadPool::enqueue(ThreadPool::Item &&item, size_t node) {
+    // 调用时必须持有 m_queue_lock
+    NodeQueue& queue = m_nodes[node];
+    queue.m_lanes[static_cast<size_t>(item.m_priority)].m_queue.push_back(std::move(item));
+    queue.m_queued++;
+    m_queued++;
+}
+
+bool ThreadPool::dequeue(ThreadPool::Item &item, size_t node) {
+    // 调用时必须持有 m_queue_lock
+    if (m_queued == 0) return false;
+
+    // 先拿自己 node 的, 没有了再去别的 node 拿, 不让 worker 闲着
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        NodeQueue& queue = m_nodes[(node + i) % m_nodes.size()];
+        if (queue.m_queued == 0) continue;
+
+        // 按优先级找第一个还有额度的非空 lane
+        // 非空的 lane 额度都用完了就开始新的一轮, 按权重重新发额度
+        for (int round = 0; round < 2; round++) {
+            for (Lane& lane : queue.m_lanes) {
+                if (lane.m_queue.empty() || lane.m_credit == 0) continue;
+                lane.m_credit--;
+                item = std::move(lane.m_queue.front());
+                lane.m_queue.pop_front();
+                queue.m_queued--;
+                m_queued--;
+                if (m_blocked_producers > 0) m_queue_not_full.notify_one();
+                return true;
+            }
+            for (Lane& lane : queue.m_lanes) lane.m_credit = lane.m_weight;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::admit(std::unique_lock<std::mutex> &locker, size_t count, bool try_only, std::vector<Item> &dropped) {
+    // 调用时必须持有 m_queue_lock
+    if (m_capacity == 0 || m_queued + count <= m_capacity) return true;
+
+    if (try_only || m_overflow == Overflow::Reject) {
+        m_rejected.fetch_add(count, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (m_overflow == Overflow::DropOldest) {
+        // 从最低优先级往上找, 每个 node 轮流丢, 跳过 try_put 进来的
+        // 剩下的全都不能丢的话就不丢了, 照样放进去
+        bool progress = true;
+        while (progress && m_queued + count > m_capacity) {
+            progress = false;
+            for (NodeQueue& queue : m_nodes) {
+                for (size_t i = Lanes; i-- > 0;) {
+                    RingQueue<Item>& items = queue.m_lanes[i].m_queue;
+                    size_t at = 0;
+                    while (at < items.size() && !items[at].m_droppable) at++;
+                    if (at == items.size()) continue;
+                    dropped.push_back(items.take(at));
+                    queue.m_queued--;
+                    m_queued--;
+                    progress = true;
+                    break;
+                }
+                if (m_queued + count <= m_capacity) break;
+            }
+        }
+        return true;
+    }
+
+    // Block, 但是自己的 worker 不能等, 否则可能所有 worker 都在等自己腾位置
+    Worker* worker = current;
+    if (worker != nullptr && worker->m_pool == this) return true;
+
+    // 一批比整个容量还大的话, 等到队列空了就放进去
+    m_blocked_producers++;
+    m_queue_not_full.wait(locker, [this, count](){
+        return m_stop || m_queued == 0 || m_queued + count <= m_capacity;
+    });
+    m_blocked_producers--;
+    return true;
+}
+
+bool ThreadPool::crossedHigh() {
+    // 调用时必须持有 m_queue_lock
+    if (m_high_watermark == 0 || m_above_watermark || m_queued < m_high_watermark) return false;
+    m_above_watermark = true;
+    return static_cast<bool>(m_on_watermark);
+}
+
+bool ThreadPool::crossedLow() {
+    // 调用时必须持有 m_queue_lock
+    if (!m_above_watermark || m_queued > m_low_watermark) return false;
+    m_above_watermark = false;
+    return static_cast<bool>(m_on_watermark);
+}
+
+void ThreadPool::discard(std::vector<Item> &dropped) {
+    // 锁外销毁, submit 出来的任务析构时会完成 Future, 可能直接跑 continuation
+    if (dropped.empty()) return;
+    size_t count = dropped.size();
+    dropped.clear();
+    m_dropped.fetch_add(count, std::memory_order_relaxed);
+    m_stats.dropped(count);
+    for (size_t i = 0; i < count; i++) finish();
+}
+
+size_t ThreadPool::route(size_t node) {
+    if (node != AnyNode || m_nodes.size() == 1) return node == AnyNode ? 0 : node;
+
+    // 没指定的话, worker 里投的进自己的 node, 外面投的轮流分给各个 node
+    Worker* worker = current;
+    if (worker != nullptr && worker->m_pool == this) return worker->m_node;
+    return m_next_node.fetch_add(1, std::memory_order_relaxed) % m_nodes.size();
+}
+
+void ThreadPool::finish() {
+    // 只有归零的那一下才去碰锁, 平时就是一次原子减
+    if (m_outstanding.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        {
+            std::lock_guard<std::mutex> sp (m_idle_lock);
+            m_idle.notify_all();
+        }
+        if (m_on_idle) m_on_idle();
+    }
+}
+
+void ThreadPool::on_idle(const std::function<void ()> &hook) {
+    m_on_idle = hook;
 }
 
 bool ThreadPool::busy() {
-    std::lock_guard<std::mutex> sp (m_queue_lock);
-    return m_busy_threads > 0 || !m_task_queue.empty();
+    return pending() > 0;
 }
 
-void ThreadPool::put(const ThreadPool::Task &task){
+size_t ThreadPool::pending() const {
+    int64_t outstanding = m_outstanding.load(std::memory_order_acquire);
+    return outstanding > 0 ? static_cast<size_t>(outstanding) : 0;
+}
+
+void ThreadPool::wait_idle() {
+    std::unique_lock<std::mutex> locker(m_idle_lock);
+    m_idle.wait(locker, [this](){ return pending() == 0; });
+}
+
+bool ThreadPool::put(const ThreadPool::Task &task){
+    return push(UniqueTask(task));
+}
+
+bool ThreadPool::put_bulk(std::vector<ThreadPool::Task> &&tasks) {
+    std::vector<UniqueTask> unique;
+    unique.reserve(tasks.size());
+    for (Task& task : tasks) unique.emplace_back(std::move(task));
+    tasks.clear();
+    return pushBulk(std::move(unique));
+}
+
+bool ThreadPool::push(UniqueTask &&task, Priority priority, Clock::time_point deadline, size_t node, bool try_only) {
+    bool routable = priority == Priority::Normal && deadline == Clock::time_point::max() && node == AnyNode;
+
+    Worker* worker = current;
+    if (routable && m_mode == Mode::WorkStealing && worker != nullptr && worker->m_pool == this) {
+        // 入队之前就要计数, 不然任务可能先跑完把计数减成负的
+        m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        m_stats.enqueued(1);
+        pushLocal(worker, std::move(task), priority, deadline);
+        worker->m_local_pushes.fetch_add(1, std::memory_order_relaxed);
+        m_local_pending++;
+
+        // 有人在睡才需要叫醒, 拿一下锁保证对方已经进入 wait
+        if (m_sleeping_threads > 0) {
+            { std::lock_guard<std::mutex> sp (m_queue_lock); }
+            notify(1);
+        }
+        grow();
+        return true;
+    }
+
+    Item item(std::move(task), priority, deadline, !try_only);
+    std::vector<Item> dropped;
+    bool high = false;
     {
-        std::lock_guard<std::mutex> sp (m_queue_lock);
-        m_task_queue.push(create(task));
+        size_t target = route(node);
+        std::unique_lock<std::mutex> locker(m_queue_lock);
+        if (!admit(locker, 1, try_only, dropped)) return false;
+        m_outstanding.fetch_add(1, std::memory_order_relaxed);
+        m_stats.enqueued(1);
+        enqueue(std::move(item), target);
+        high = crossedHigh();
+    }
+    discard(dropped);
+    if (high) m_on_watermark(true);
+
+    m_injections.fetch_add(1, std::memory_order_relaxed);
+    notify(1);
+    grow();
+    return true;
+}
+
+bool ThreadPool::pushBulk(std::vector<UniqueTask> &&tasks) {
+    size_t count = tasks.size();
+    if (count == 0) return true;
+
+    Worker* worker = current;
+    if (m_mode == Mode::WorkStealing && worker != nullptr && worker->m_pool == this) {
+        m_outstanding.fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed);
+        m_stats.enqueued(count);
+        for (UniqueTask& task : tasks) {
+            pushLocal(worker, std::move(task), Priority::Normal, Clock::time_point::max());
+        }
+        worker->m_local_pushes.fetch_add(count, std::memory_order_relaxed);
+        m_local_pending += static_cast<int64_t>(count);
+
+        if (m_sleeping_threads > 0) {
+            { std::lock_guard<std::mutex> sp (m_queue_lock); }
+            notify(count);
+        }
+        grow();
+        return true;
+    }
+
+    // 整批只拿一次锁
+    std::vector<Item> dropped;
+    bool high = false;
+    {
+        size_t target = route(AnyNode);
+        std::unique_lock<std::mutex> locker(m_queue_lock);
+        if (!admit(locker, count, false, dropped)) return false;
+        m_outstanding.fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed);
+        m_stats.enqueued(count);
+        for (UniqueTask& task : tasks) {
+            enqueue(Item(std::move(task), Priority::Normal, Clock::time_point::max()), target);
+        }
+        high = crossedHigh();
+    }
+    discard(dropped);
+    if (high) m_on_watermark(true);
+
+    m_injections.fetch_add(count, std::memory_order_relaxed);
+    notify(count);
+    grow();
+    return true;
+}
+
+bool ThreadPool::elastic() const {
+    return m_max_threads > m_min_threads;
+}
+
+void ThreadPool::grow() {
+    // 固定大小, 或者有人闲着, 或者已经到上限了, 都不用加线程
+    if (!elastic() || m_sleeping_threads > 0 || m_live_threads >= m_max_threads) return;
+
+    std::lock_guard<std::mutex> sp (m_queue_lock);
+    if (m_stop || m_sleeping_threads > 0 || m_live_threads >= m_max_threads) return;
+    if (m_queued == 0 && m_local_pending <= 0) return;
+    spawn();
+}
+
+void ThreadPool::spawn() {
+    // 调用时必须持有 m_queue_lock
+    for (std::unique_ptr<Worker>& worker : m_workers) {
+        if (worker->m_active) continue;
+
+        // 之前退出的线程只是从 run 返回, 不会再碰锁, 这里 join 不会卡住
+        if (worker->m_thread.joinable()) worker->m_thread.join();
+
+        worker->m_active = true;
+        m_live_threads++;
+        m_spawns.fetch_add(1, std::memory_order_relaxed);
+        worker->m_thread = std::thread(&run, this, worker.get());
+        return;
     }
-    m_queue_not_empty.notify_one();
 }
 
-ThreadPool::ThreadPool(size_t init_size)
-    : m_busy_threads(0) {
-    for (size_t i = 0; i < init_size; i++) {
-        m_threads.push_back(std::thread(&run, this));
+void ThreadPool::notify(size_t count) {
+    // 在睡的 worker 都是在锁里登记的, 任务入队以后再读这个数就不会漏
+    // 只叫醒 min(任务数, 睡着的 worker 数) 个, 没人睡就一个都不叫
+    int sleeping = m_sleeping_threads.load();
+    if (sleeping <= 0) return;
+
+    size_t wake = std::min(count, static_cast<size_t>(sleeping));
+    m_wakeups.fetch_add(wake, std::memory_order_relaxed);
+    if (wake == static_cast<size_t>(sleeping)) {
+        m_queue_not_empty.notify_all();
+    } else {
+        for (size_t i = 0; i < wake; i++) m_queue_not_empty.notify_one();
+    }
+}
+
+size_t ThreadPool::size() const {
+    return m_live_threads.load(std::memory_order_relaxed);
+}
+
+size_t ThreadPool::idle() const {
+    int sleeping = m_sleeping_threads.load(std::memory_order_relaxed);
+    return sleeping > 0 ? static_cast<size_t>(sleeping) : 0;
+}
+
+ThreadPool::Counters ThreadPool::counters() const {
+    Counters counters;
+    counters.injections = m_injections.load(std::memory_order_relaxed);
+    counters.wakeups = m_wakeups.load(std::memory_order_relaxed);
+    counters.spawns = m_spawns.load(std::memory_order_relaxed);
+    counters.retirements = m_retirements.load(std::memory_order_relaxed);
+    counters.expired = m_expired.load(std::memory_order_relaxed);
+    counters.rejected = m_rejected.load(std::memory_order_relaxed);
+    counters.dropped = m_dropped.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<Worker>& worker : m_workers) {
+        counters.local_pushes += worker->m_local_pushes.load(std::memory_order_relaxed);
+        counters.local_hits += worker->m_local_hits.load(std::memory_order_relaxed);
+        counters.steals += worker->m_steals.load(std::memory_order_relaxed);
+    }
+    return counters;
+}
+
+ThreadPoolSnapshot ThreadPool::snapshot() const {
+    return m_stats.snapshot();
+}
+
+ThreadPool::Mode ThreadPool::mode() const {
+    return m_mode;
+}
+
+size_t ThreadPool::node_count() const {
+    return m_nodes.size();
+}
+
+size_t ThreadPool::current_node() const {
+    Worker* worker = current;
+    return (worker != nullptr && worker->m_pool == this) ? worker->m_node : AnyNode;
+}
+
+static ThreadPool::Options fixedOptions(size_t size, ThreadPool::Mode mode) {
+    ThreadPool::Options options;
+    options.mode = mode;
+    options.min_threads = size;
+    options.max_threads = size;
+    return options;
+}
+
+ThreadPool::ThreadPool(size_t init_size, Mode mode)
+    : ThreadPool(fixedOptions(init_size, mode)) { }
+
+ThreadPool::ThreadPool(const Options& options)
+    : m_mode(options.mode)
+    , m_min_threads(options.min_threads)
+    , m_max_threads(std::max(options.min_threads, options.max_threads))
+    , m_idle_timeout(options.idle_timeout)
+    , m_on_expired(options.on_expired)
+    , m_capacity(options.capacity)
+    , m_overflow(options.overflow)
+    , m_high_watermark(options.high_watermark)
+    , m_low_watermark(std::min(options.low_watermark, options.high_watermark))
+    , m_on_watermark(options.on_watermark)
+    , m_blocked_producers(0)
+    , m_above_watermark(false)
+    , m_queued(0)
+    , m_next_node(0)
+    , m_stop(false)
+    , m_live_threads(0)
+    , m_outstanding(0)
+    , m_sleeping_threads(0)
+    , m_local_pending(0)
+    , m_injections(0)
+    , m_wakeups(0)
+    , m_spawns(0)
+    , m_retirements(0)
+    , m_expired(0)
+    , m_rejected(0)
+    , m_dropped(0)
+    , m_stats(m_max_threads) {
+    // 决定每个 node 用哪些 CPU, 不开 numa 的时候只有一个不绑核的 node
+    std::vector<Numa::Node> topology;
+    if (options.numa) {
+        for (Numa::Node& node : Numa::nodes()) {
+            if (!options.cpus.empty()) {
+                std::vector<int> cpus;
+                for (int cpu : node.m_cpus) {
+                    if (std::find(options.cpus.begin(), options.cpus.end(), cpu) != options.cpus.end()) cpus.push_back(cpu);
+                }
+                node.m_cpus = cpus;
+            }
+            if (!node.m_cpus.empty()) topology.push_back(node);
+        }
+    }
+
+    // NodeQueue 里的队列搬不动, 只能一次建好
+    std::vector<NodeQueue>(std::max<size_t>(topology.size(), 1)).swap(m_nodes);
+    for (size_t i = 0; i < m_nodes.size(); i++) {
+        if (!topology.empty()) m_nodes[i].m_id = topology[i].m_id;
+        for (size_t j = 0; j < Lanes; j++) {
+            Lane& lane = m_nodes[i].m_lanes[j];
+            lane.m_weight = std::max(options.weights[j], 1u);
+            lane.m_credit = lane.m_weight;
+        }
+    }
+
+    // 先把所有槽都建好再起线程, steal 的时候会遍历 m_workers
+    for (size_t i = 0; i < m_max_threads; i++) {
+        Worker* worker = new Worker(this, i);
+        if (!topology.empty()) {
+            worker->m_node = i % topology.size();
+            worker->m_cpus = topology[worker->m_node].m_cpus;
+        } else if (!options.cpus.empty()) {
+            worker->m_cpus.push_back(options.cpus[i % options.cpus.size()]);
+        }
+        m_workers.emplace_back(worker);
+    }
+
+    std::lock_guard<std::mutex> sp (m_queue_lock);
+    for (size_t i = 0; i < m_min_threads; i++) {
+        spawn();
     }
 }
 
 ThreadPool::~ThreadPool() {
     {
         std::lock_guard<std::mutex> sp (m_queue_lock);
-        for (size_t i = 0; i < m_threads.size(); i++) {
-            m_task_queue.push(create([]{}, false));
-        }
+        m_stop = true;
     }
 
     m_queue_not_empty.notify_all();
+    m_queue_not_full.notify_all();
 
-    for (std::thread& thread : m_threads) {
-        thread.join();
+    for (std::unique_ptr<Worker>& worker : m_workers) {
+        if (worker->m_thread.joinable()) worker->m_thread.join();
     }
 }
 
@@ -8,11 +8,23 @@
 #include <mutex>
 #include <condition_variable>
 #include <queue>
+#include <deque>
+#include <array>
 #include <memory>
 #include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
 
 #include <iostream>
 
+#include "Future.hpp"
+#include "MpscQueue.hpp"
+#include "RingQueue.hpp"
+#include "ThreadPoolStats.hpp"
+#include "UniqueTask.hpp"
+#include "WorkStealingDeque.hpp"
+
 namespace blxcpp {
 
 class ThreadPool {
@@ -21,26 +33,293 @@ public:
 
     using Task = std::function<void()>;
 
+    // Shared: 所有 worker 抢同一个队列
+    // WorkStealing: 每个 worker 有自己的 Chase-Lev 队列, 闲下来就去偷别人的
+    //   worker 里面 put 的任务进自己的队列, 外部 put 的任务进共享的注入队列
+    enum class Mode { Shared, WorkStealing };
+
+    // 共享队列按优先级分成几条 lane, 每条一个队列
+    // 出队按 Options::weights 加权轮转, 所以低优先级的 lane 不会被饿死
+    enum class Priority { High = 0, Normal = 1, Low = 2 };
+    static const size_t Lanes = 3;
+
+    using Clock = std::chrono::steady_clock;
+
+    // 共享队列满了以后怎么办
+    // Block: 投递的线程等到有空位; Reject: put 返回 false; DropOldest: 丢掉最低优先级 lane 里最老的任务
+    enum class Overflow { Block, Reject, DropOldest };
+
+    // 调度计数, 用来确认 work stealing 到底有没有起作用
+    struct Counters {
+        uint64_t injections = 0;   // 从外部进入共享队列的任务数
+        uint64_t local_pushes = 0; // worker 里 put 进自己队列的任务数
+        uint64_t local_hits = 0;   // 从自己队列里拿到的任务数
+        uint64_t steals = 0;       // 从别的 worker 那里偷到的任务数
+        uint64_t wakeups = 0;      // 入队时发出的唤醒次数
+        uint64_t spawns = 0;       // 弹性模式下新起的线程数
+        uint64_t retirements = 0;  // 弹性模式下闲置超时退出的线程数
+        uint64_t expired = 0;      // 出队时已经过了截止时间被丢掉的任务数
+        uint64_t rejected = 0;     // 队列满了被拒绝的任务数
+        uint64_t dropped = 0;      // DropOldest 丢掉的任务数
+    };
+
+    // min_threads == max_threads (max_threads 为 0 时也视为相等) 就是固定大小
+    // 否则是弹性模式: 所有线程都在忙并且还有任务排队时加线程, 最多加到 max_threads
+    // 闲置超过 idle_timeout 的线程会退出, 最少保留 min_threads 个
+    struct Options {
+        Mode mode = Mode::Shared;
+        size_t min_threads = std::thread::hardware_concurrency();
+        size_t max_threads = 0;
+        std::chrono::milliseconds idle_timeout = std::chrono::milliseconds(10000);
+
+        // 各 lane 在一轮里最多出队几个, 按 Priority 的顺序
+        std::array<unsigned, Lanes> weights = {{ 4, 2, 1 }};
+
+        // 过期任务被丢掉时在 worker 线程上回调, 可以不设
+        std::function<void(Priority)> on_expired;
+
+        // 非空的话把 worker 轮流绑到这些 CPU 上 (每个 worker 一个 CPU)
+        std::vector<int> cpus;
+
+        // 按 /sys/devices/system/node 的拓扑把 worker 平均分到各个 NUMA node
+        // 每个 worker 绑到自己 node 的 CPU 上 (和 cpus 取交集), 内存也优先从本 node 分配
+        // 每个 node 有自己的子队列, 可以用 put_on_node 把任务投到指定 node
+        bool numa = false;
+
+        // 共享队列的容量, 0 表示不限; worker 本地的 work stealing 队列不计在内
+        // 池子自己的 worker 往里投的时候不会被 Block 卡住, 不然所有 worker 可能都卡在投递上
+        size_t capacity = 0;
+        Overflow overflow = Overflow::Block;
+
+        // 共享队列长度涨到 high_watermark 时回调 on_watermark(true), 回落到 low_watermark 时回调 false
+        // 让上游在真的满之前就开始减负, high_watermark 为 0 表示不用; 回调在投递 / 取任务的线程上, 锁外执行
+        size_t high_watermark = 0;
+        size_t low_watermark = 0;
+        std::function<void(bool)> on_watermark;
+    };
+
+    static const size_t AnyNode = static_cast<size_t>(-1);
+
 private:
-    using TaskS = std::function<bool()>;
+    // 继承 Stamp: 打开统计时记录入队时间, 关闭时是空基类不占空间
+    struct Item : ThreadPoolStats::Stamp {
+        UniqueTask m_task;
+        Clock::time_point m_deadline;
+        Priority m_priority;
+        bool m_droppable; // try_put 进来的任务不会被 DropOldest 丢掉
+
+        Item()
+            : m_deadline(Clock::time_point::max()), m_priority(Priority::Normal), m_droppable(true) { }
+        Item(UniqueTask&& task, Priority priority, Clock::time_point deadline, bool droppable = true)
+            : m_task(std::move(task)), m_deadline(deadline), m_priority(priority), m_droppable(droppable) { stamp(); }
+    };
+
+    struct Lane {
+        RingQueue<Item> m_queue; // 稳定以后入队出队都不分配
+        unsigned m_weight = 1;
+        unsigned m_credit = 1; // 这一轮还能出队几个
+    };
+
+    // 每个 NUMA node 一组 lane, 没开 numa 的时候只有一个
+    struct NodeQueue {
+        int m_id = 0;
+        std::array<Lane, Lanes> m_lanes;
+        size_t m_queued = 0;
+    };
+
+    struct Worker;
+
+    // worker 本地队列里放的节点, 跑完不 delete, 还给分配它的 worker 下次接着用
+    // 自己 pop 出来的直接放回自己的空闲列表, 被别人偷走的通过 m_returned 还回来
+    struct LocalItem : MpscNode {
+        Item m_item;
+        Worker* m_owner;
+
+        explicit LocalItem(Worker* owner)
+            : m_owner(owner) { }
+    };
+
+    struct Worker {
+        Pool* m_pool;
+        size_t m_index;
+        std::thread m_thread;
+        bool m_active; // 由 m_queue_lock 保护, 退出的线程留在槽里等下次复用时 join
+        size_t m_node; // 在 m_nodes 里的下标
+        std::vector<int> m_cpus;
+        WorkStealingDeque<LocalItem> m_deque;
+        std::vector<LocalItem*> m_free;  // 只有占着这个槽的线程访问
+        size_t m_owned;                  // 这个槽一共分配过几个节点
+        MpscQueue<LocalItem> m_returned; // 别的 worker 偷走跑完还回来的
+        std::atomic<uint64_t> m_local_pushes;
+        std::atomic<uint64_t> m_local_hits;
+        std::atomic<uint64_t> m_steals;
+
+        Worker(Pool* pool, size_t index)
+            : m_pool(pool), m_index(index), m_active(false), m_node(0), m_owned(0)
+            , m_local_pushes(0), m_local_hits(0), m_steals(0) { }
+
+        ~Worker() {
+            for (LocalItem* node : m_free) delete node;
+        }
+    };
+
+    const Mode m_mode;
+    const size_t m_min_threads;
+    const size_t m_max_threads;
+    const std::chrono::milliseconds m_idle_timeout;
+    const std::function<void(Priority)> m_on_expired;
+    const size_t m_capacity;
+    const Overflow m_overflow;
+    const size_t m_high_watermark;
+    const size_t m_low_watermark;
+    const std::function<void(bool)> m_on_watermark;
 
     std::mutex m_queue_lock;
     std::condition_variable m_queue_not_empty;
-    std::queue<TaskS> m_task_queue;
+    std::condition_variable m_queue_not_full;
+    size_t m_blocked_producers; // 等空位的线程数, 由 m_queue_lock 保护
+    bool m_above_watermark;     // 由 m_queue_lock 保护
+    std::vector<NodeQueue> m_nodes;
+    size_t m_queued; // 所有 node 所有 lane 里的任务总数
+    std::atomic<size_t> m_next_node;
+    bool m_stop;
+
+    // 按 max_threads 预先建好所有槽, 之后不再增删, steal 的时候可以放心遍历
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::atomic<size_t> m_live_threads;
+    // 已经投递但还没执行完的任务数, 归零的时候通知 wait_idle
+    std::atomic<int64_t> m_outstanding;
+    std::mutex m_idle_lock;
+    std::condition_variable m_idle;
+    std::function<void()> m_on_idle;
+
+    std::atomic<int> m_sleeping_threads;  // 正在等任务的 worker 数
+    std::atomic<int64_t> m_local_pending; // 所有 worker 本地队列里的任务总数
+    std::atomic<uint64_t> m_injections;
+    std::atomic<uint64_t> m_wakeups;
+    std::atomic<uint64_t> m_spawns;
+    std::atomic<uint64_t> m_retirements;
+    std::atomic<uint64_t> m_expired;
+    std::atomic<uint64_t> m_rejected;
+    std::atomic<uint64_t> m_dropped;
 
-    std::vector<std::thread> m_threads;
-    std::atomic<int> m_busy_threads;
+    ThreadPoolStats m_stats;
+
+    static thread_local Worker* current;
 
 private:
 
-    static void run(Pool* pool);
-    static TaskS create(const Task& task, bool signal = true);
+    static void run(Pool* pool, Worker* worker);
+
+    void runShared(Worker* worker);
+    void runStealing(Worker* worker);
+    bool take(Worker* worker, Item& item);
+    void pushLocal(Worker* worker, UniqueTask&& task, Priority priority, Clock::time_point deadline);
+    void release(Worker* worker, LocalItem* node);
+    void execute(Item& item, Worker* worker);
+    void enqueue(Item&& item, size_t node);
+    bool dequeue(Item& item, size_t node);
+    bool admit(std::unique_lock<std::mutex>& locker, size_t count, bool try_only, std::vector<Item>& dropped);
+    bool crossedHigh();
+    bool crossedLow();
+    void discard(std::vector<Item>& dropped);
+    size_t route(size_t node);
+    bool push(UniqueTask&& task, Priority priority = Priority::Normal,
+              Clock::time_point deadline = Clock::time_point::max(), size_t node = AnyNode, bool try_only = false);
+    bool pushBulk(std::vector<UniqueTask>&& tasks);
+    void notify(size_t count);
+    void finish();
+
+    bool elastic() const;
+    void grow();
+    void spawn();
+
+    template<typename Pred>
+    bool sleep(std::unique_lock<std::mutex>& locker, Worker* worker, Pred ready);
 
 public:
 
     bool busy();
-    void put(const Task& task);
-    ThreadPool(size_t init_size = std::thread::hardware_concurrency());
+
+    // 还没执行完的任务数 (包括排队的和正在跑的), 不加锁, 只是快照
+    size_t pending() const;
+
+    // 阻塞到所有已投递的任务都执行完, 不要在池子自己的任务里调用
+    void wait_idle();
+
+    // 同上, 超时返回 false
+    template<typename Rep, typename Period>
+    bool wait_idle_for(const std::chrono::duration<Rep, Period>& timeout) {
+        std::unique_lock<std::mutex> locker(m_idle_lock);
+        return m_idle.wait_for(locker, timeout, [this](){ return pending() == 0; });
+    }
+
+    // 未完成任务数归零的时候在 worker 线程上回调, 必须在投递任务之前设置
+    void on_idle(const std::function<void()>& hook);
+
+    // 队列满了并且策略是 Reject 的时候返回 false, 其他情况都返回 true
+    bool put(const Task& task);
+
+    // 直接把函数对象移进队列, 小的 lambda 不会经过 std::function 也不会分配内存
+    template<typename Func>
+    bool put(Func&& func) { return push(UniqueTask(std::forward<Func>(func))); }
+
+    // 指定优先级和截止时间, 出队时已经过了截止时间的任务不会执行, 会计入 expired
+    // 不是 Normal 或者带截止时间的任务总是进共享的 lane, 不会进 worker 的本地队列
+    template<typename Func>
+    bool put(Func&& func, Priority priority, Clock::time_point deadline = Clock::time_point::max()) {
+        return push(UniqueTask(std::forward<Func>(func)), priority, deadline);
+    }
+
+    // 投到指定 NUMA node 的子队列, 会优先由那个 node 上的 worker 执行
+    template<typename Func>
+    bool put_on_node(size_t node, Func&& func, Priority priority = Priority::Normal) {
+        return push(UniqueTask(std::forward<Func>(func)), priority, Clock::time_point::max(), node % m_nodes.size());
+    }
+
+    // 不管 overflow 是什么策略, 满了就直接返回 false, 不阻塞也不丢别的任务
+    // 进了队列的任务也不会被 DropOldest 丢掉, 所以返回 true 就一定会执行 (除非过了截止时间)
+    template<typename Func>
+    bool try_put(Func&& func, Priority priority = Priority::Normal) {
+        return push(UniqueTask(std::forward<Func>(func)), priority, Clock::time_point::max(), AnyNode, true);
+    }
+
+    // 批量投递: 整批只拿一次锁, 只叫醒 min(批大小, 空闲 worker 数) 个线程
+    // 有容量限制时整批一起判断, Reject 的话整批都不进
+    template<typename Iter>
+    bool put_bulk(Iter begin, Iter end) {
+        std::vector<UniqueTask> tasks;
+        for (; begin != end; ++begin) tasks.emplace_back(*begin);
+        return pushBulk(std::move(tasks));
+    }
+
+    bool put_bulk(std::vector<Task>&& tasks);
+
+    // 和 put 一样投递任务, 但是通过 Future 把结果 (或者异常) 带回来
+    // 被拒绝或者被丢掉的任务, Future 里拿到的是 broken_promise
+    template<typename Func, typename ...Args>
+    auto submit(Func&& func, Args&&... args)
+        -> Future<typename std::result_of<typename std::decay<Func>::type(typename std::decay<Args>::type...)>::type> {
+        using Ret = typename std::result_of<typename std::decay<Func>::type(typename std::decay<Args>::type...)>::type;
+        auto state = std::make_shared<FutureState<Ret>>();
+        push(UniqueTask(FutureTask<Ret, typename std::decay<Func>::type, typename std::decay<Args>::type...>(
+                            state, std::forward<Func>(func), std::forward<Args>(args)...)));
+        return Future<Ret>(state);
+    }
+
+    Counters counters() const;
+
+    // 延迟直方图, 队列深度和 worker 利用率, 随时可以读, 不会停下线程池
+    // 需要编译时定义 BLXCPP_THREADPOOL_STATS=1, 否则返回的 enabled 为 false
+    ThreadPoolSnapshot snapshot() const;
+    size_t size() const; // 当前活着的线程数
+    size_t idle() const; // 正在等任务的 worker 数, 只是快照
+    Mode mode() const;
+    size_t node_count() const;
+    size_t current_node() const; // 当前线程所在 worker 的 node, 不是这个池子的 worker 就返回 AnyNode
+
+    ThreadPool(size_t init_size = std::thread::hardware_concurrency(), Mode mode = Mode::Shared);
+    explicit ThreadPool(const Options& options);
     ~ThreadPool();
 
 };
@@ -0,0 +1,203 @@
+// ThreadPoolStats.hpp
+#ifndef BLXCPP_THREADPOOLSTATS_HPP
+#define BLXCPP_THREADPOOLSTATS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+// 编译期开关, 默认关闭, 关闭时所有统计调用都是空的内联函数, 队列元素也不会变大
+// 要打开的话所有包含 ThreadPool.hpp 的编译单元都必须用同一个值
+#ifndef BLXCPP_THREADPOOL_STATS
+#define BLXCPP_THREADPOOL_STATS 0
+#endif
+
+namespace blxcpp {
+
+// 以 2 的幂纳秒分桶的直方图, 第 i 个桶是 [2^i, 2^(i+1)) ns
+struct LatencyHistogram {
+    static const size_t Buckets = 40;
+
+    std::array<uint64_t, Buckets> counts = {{ }};
+    uint64_t count = 0;
+    uint64_t sum_ns = 0;
+    uint64_t max_ns = 0;
+
+    static size_t bucket(uint64_t ns) {
+        size_t i = 0;
+#ifdef __GNUC__
+        i = static_cast<size_t>(63 - __builtin_clzll(ns | 1));
+#else
+        while (ns >>= 1) i++;
+#endif
+        return i < Buckets ? i : Buckets - 1;
+    }
+
+    double mean_ns() const { return count == 0 ? 0.0 : static_cast<double>(sum_ns) / count; }
+
+    // 返回所在桶的上界, 所以是个偏大的估计, p 取 0~1
+    uint64_t percentile_ns(double p) const {
+        if (count == 0) return 0;
+        uint64_t rank = static_cast<uint64_t>(p * count);
+        if (rank >= count) rank = count - 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < Buckets; i++) {
+            seen += counts[i];
+            if (seen > rank) return std::min<uint64_t>((uint64_t(2) << i) - 1, max_ns);
+        }
+        return max_ns;
+    }
+};
+
+struct ThreadPoolSnapshot {
+    bool enabled = false;
+    LatencyHistogram queue_latency; // 入队到开始执行
+    LatencyHistogram run_time;      // 执行耗时
+    uint64_t queue_depth = 0;       // 当前排队 (还没开始执行) 的任务数
+    uint64_t queue_depth_high_water = 0;
+    std::vector<double> utilization; // 每个 worker 槽从线程池创建到现在忙碌的时间比例
+};
+
+template <bool Enabled>
+class BasicThreadPoolStats;
+
+// 关闭时: 什么都不做
+template <>
+class BasicThreadPoolStats<false> {
+public:
+    // 队列元素继承它, 空基类不占空间
+    struct Stamp {
+        void stamp() { }
+    };
+
+    explicit BasicThreadPoolStats(size_t) { }
+
+    void enqueued(size_t) { }
+    void dropped(size_t) { }
+    Stamp started(const Stamp&) { return Stamp(); }
+    void finished(size_t, const Stamp&) { }
+
+    ThreadPoolSnapshot snapshot() const { return ThreadPoolSnapshot(); }
+};
+
+// 打开时: 全部用 relaxed 原子量, snapshot 不用停下线程池
+template <>
+class BasicThreadPoolStats<true> {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Stamp {
+        Clock::time_point m_at;
+        void stamp() { m_at = Clock::now(); }
+    };
+
+private:
+    class Recorder {
+    private:
+        std::array<std::atomic<uint64_t>, LatencyHistogram::Buckets> m_counts;
+        std::atomic<uint64_t> m_count;
+        std::atomic<uint64_t> m_sum_ns;
+        std::atomic<uint64_t> m_max_ns;
+
+    public:
+        Recorder()
+            : m_count(0), m_sum_ns(0), m_max_ns(0) {
+            for (std::atomic<uint64_t>& count : m_counts) count.store(0, std::memory_order_relaxed);
+        }
+
+        void record(uint64_t ns) {
+            m_counts[LatencyHistogram::bucket(ns)].fetch_add(1, std::memory_order_relaxed);
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            m_sum_ns.fetch_add(ns, std::memory_order_relaxed);
+            uint64_t max = m_max_ns.load(std::memory_order_relaxed);
+            while (ns > max && !m_max_ns.compare_exchange_weak(max, ns, std::memory_order_relaxed)) { }
+        }
+
+        LatencyHistogram load() const {
+            LatencyHistogram histogram;
+            for (size_t i = 0; i < LatencyHistogram::Buckets; i++) {
+                histogram.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+            }
+            histogram.count = m_count.load(std::memory_order_relaxed);
+            histogram.sum_ns = m_sum_ns.load(std::memory_order_relaxed);
+            histogram.max_ns = m_max_ns.load(std::memory_order_relaxed);
+            return histogram;
+        }
+    };
+
+    static uint64_t elapsed(Clock::time_point from, Clock::time_point to) {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(to - from).count();
+        return ns > 0 ? static_cast<uint64_t>(ns) : 0;
+    }
+
+    const Clock::time_point m_created;
+    Recorder m_queue_latency;
+    Recorder m_run_time;
+    std::atomic<int64_t> m_depth;
+    std::atomic<int64_t> m_depth_high_water;
+    const size_t m_workers;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_busy_ns;
+
+public:
+    explicit BasicThreadPoolStats(size_t workers)
+        : m_created(Clock::now())
+        , m_depth(0)
+        , m_depth_high_water(0)
+        , m_workers(workers)
+        , m_busy_ns(new std::atomic<uint64_t>[workers]) {
+        for (size_t i = 0; i < workers; i++) m_busy_ns[i].store(0, std::memory_order_relaxed);
+    }
+
+    void enqueued(size_t count) {
+        int64_t depth = m_depth.fetch_add(static_cast<int64_t>(count), std::memory_order_relaxed) + static_cast<int64_t>(count);
+        int64_t high = m_depth_high_water.load(std::memory_order_relaxed);
+        while (depth > high && !m_depth_high_water.compare_exchange_weak(high, depth, std::memory_order_relaxed)) { }
+    }
+
+    // 还没执行就被丢掉的
+    void dropped(size_t count) {
+        m_depth.fetch_sub(static_cast<int64_t>(count), std::memory_order_relaxed);
+    }
+
+    Stamp started(const Stamp& enqueued_at) {
+        Stamp now;
+        now.stamp();
+        m_depth.fetch_sub(1, std::memory_order_relaxed);
+        m_queue_latency.record(elapsed(enqueued_at.m_at, now.m_at));
+        return now;
+    }
+
+    void finished(size_t worker, const Stamp& started_at) {
+        uint64_t ns = elapsed(started_at.m_at, Clock::now());
+        m_run_time.record(ns);
+        m_busy_ns[worker].fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    ThreadPoolSnapshot snapshot() const {
+        ThreadPoolSnapshot snapshot;
+        snapshot.enabled = true;
+        snapshot.queue_latency = m_queue_latency.load();
+        snapshot.run_time = m_run_time.load();
+        int64_t depth = m_depth.load(std::memory_order_relaxed);
+        snapshot.queue_depth = depth > 0 ? static_cast<uint64_t>(depth) : 0;
+        snapshot.queue_depth_high_water = static_cast<uint64_t>(m_depth_high_water.load(std::memory_order_relaxed));
+
+        double wall = static_cast<double>(elapsed(m_created, Clock::now()));
+        for (size_t i = 0; i < m_workers; i++) {
+            double busy = static_cast<double>(m_busy_ns[i].load(std::memory_order_relaxed));
+            snapshot.utilization.push_back(wall > 0 ? busy / wall : 0.0);
+        }
+        return snapshot;
+    }
+};
+
+using ThreadPoolStats = BasicThreadPoolStats<BLXCPP_THREADPOOL_STATS != 0>;
+
+}
+
+#endif // BLXCPP_THREADPOOLSTATS_HPP
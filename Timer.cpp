@@ -1,84 +1,328 @@
 // Timer.cpp
 #include "Timer.hpp"
 
+#include <memory>
+
 namespace blxcpp {
 
-Timer::Time Timer::now() {
-    return std::chrono::duration_cast<std::chrono::milliseconds>
-            (std::chrono::system_clock::now().time_since_epoch()).count();
+namespace {
+
+// bits 里从 pos 的下一个槽开始往后数, 第一个非空的槽有多远, 结果在 [1, 64]
+unsigned distance(uint64_t bits, unsigned pos) {
+    unsigned start = (pos + 1) & 63;
+    uint64_t rotated = start == 0 ? bits : (bits >> start) | (bits << (64 - start));
+    return static_cast<unsigned>(__builtin_ctzll(rotated)) + 1;
+}
+
 }
 
-Timer::ID Timer::nextId() {
-    if (m_next_id_ < 0) m_next_id_ = 0;
-    return m_next_id_++;
+thread_local unsigned Timer::current_shard = Timer::Shards;
+std::atomic<unsigned> Timer::next_shard(0);
+
+unsigned Timer::shardIndex() {
+    if (current_shard == Shards) current_shard = next_shard.fetch_add(1, std::memory_order_relaxed) % Shards;
+    return current_shard;
 }
 
-Timer::Timer(Timer::Time current)
-    : m_current(current) { }
+Timer::Time Timer::now() {
+    return Clock::steady();
+}
+
+Timer::Timer(Timer::Time current, Timer::Time resolution)
+    : m_armed(0)
+    , m_resolution(resolution > 0 ? resolution : 1)
+    , m_now(current)
+    , m_current(current / m_resolution) {
+    for (unsigned level = 0; level < Levels; level++) m_occupied[level] = 0;
+}
 
 Timer::Timer()
-    : m_current(now()) { }
+    : Timer(now()) { }
 
-Timer::Ref Timer::setTimeout(Timer::Time timeout, bool repeat, const std::function<void ()> &func){
-    std::lock_guard<std::mutex> sp(m_lock);
-    ID id = nextId();
-    m_containers[id] = Timeout(id, m_current, repeat, timeout, func);
-    m_queue.push(&m_containers[id]);
-    return Ref(this, id);
+Timer::~Timer() {
+    // 自己的节点释放掉, 调用方的节点只是摘下来, 以后析构的时候不会再找这个 timer
+    auto release = [](List& list) {
+        for (Node* t = list.m_head; t;) {
+            Node* next = t->m_next;
+            if (t->m_owned) {
+                delete t;
+            } else {
+                t->m_timer = nullptr;
+                t->m_prev = t->m_next = nullptr;
+                t->m_level = NoLevel;
+            }
+            t = next;
+        }
+    };
+    for (unsigned level = 0; level < Levels; level++) {
+        for (unsigned slot = 0; slot < Slots; slot++) release(m_wheel[level][slot]);
+    }
+    release(m_due);
+    release(m_firing);
+    release(m_rearm);
 }
 
-void Timer::tick(Timer::Time time){
-    std::lock_guard<std::mutex> sp(m_lock);
-    m_current = time;
+Timer::Ref Timer::setTimeout(Timer::Time timeout, bool repeat, const std::function<void ()> &func, Timer::Time slack){
+    unsigned index = shardIndex();
+    Shard& shard = m_shards[index];
+    ID id = shard.m_next_id.fetch_add(1, std::memory_order_relaxed) * Shards + index;
+    Command* command = new Command();
+    command->m_id = id;
+    command->m_is_cancel = false;
+    command->m_is_repeated = repeat;
+    command->m_timeout = timeout;
+    command->m_slack = slack;
+    command->m_func = func;
+    shard.m_commands.push(command);
+    return Ref(this, id);
+}
 
-    if (!m_containers.empty()) {
+Timer::Time Timer::slotOf(Timer::Time time) const {
+    return time / m_resolution;
+}
 
-        std::vector<Timeout*> removed;
-        std::vector<Timeout*> next;
+Timer::Time Timer::deadlineOf(Timer::Time time, Timer::Time timeout, Timer::Time slack) const {
+    // 0 就是马上到期, 不用等到下一个槽
+    if (timeout <= 0) return slotOf(time);
+    Time earliest = (time + timeout + m_resolution - 1) / m_resolution;
+    Time latest = earliest + (slack > 0 ? slack / m_resolution : 0);
+    if (latest == earliest) return earliest;
 
-        while (!m_queue.empty()) {
-            Timeout* t = m_queue.top();
+    // 在 [earliest, latest] 里挑末尾 0 最多的那个槽: earliest - 1 和 latest 最高的不同位是 bit,
+    // 把 latest 在 bit 以下的位清零就是, 差不多时候到期的 timer 会挑中同一个槽
+    unsigned bit = 63 - static_cast<unsigned>(__builtin_clzll(static_cast<uint64_t>((earliest - 1) ^ latest)));
+    return latest >> bit << bit;
+}
 
-            // 如果是
-            if (!t->m_is_activated) {
-                m_queue.pop();
-                removed.emplace_back(t);
+void Timer::apply(Timer::Time time) {
+    // 同一个 timer 的 set 和 clear 在同一个分片里, 先 set 再 clear 的, 在队列里的顺序也是先 set 再 clear
+    for (Shard& shard : m_shards) {
+        while (Command* c = shard.m_commands.pop()) {
+            std::unique_ptr<Command> command(c);
+            if (command->m_is_cancel) {
+                auto it = m_timeouts.find(command->m_id);
+                if (it == m_timeouts.end()) continue;
+                unlink(it->second);
+                delete it->second;
+                m_timeouts.erase(it);
+                m_armed--;
                 continue;
             }
+            Node* t = new Node();
+            t->m_timer = this;
+            t->m_id = command->m_id;
+            t->m_owned = true;
+            t->m_is_repeated = command->m_is_repeated;
+            t->m_timeout = command->m_timeout;
+            t->m_slack = command->m_slack;
+            t->m_expried_at = deadlineOf(time, command->m_timeout, command->m_slack);
+            t->m_func = std::move(command->m_func);
+            m_timeouts[t->m_id] = t;
+            m_armed++;
+            schedule(t);
+        }
+    }
+}
 
-            if (t->m_expried_at > m_current) break;
-            m_queue.pop();
+void Timer::schedule(Timer::Node *t) {
+    if (t->m_expried_at <= m_current) {
+        link(m_due, t, DueLevel, 0);
+        return;
+    }
 
-            if (t->m_is_repeated) {
-                t->m_expried_at = m_current + t->m_timeout;
-                next.emplace_back(t);
-            } else {
-                removed.emplace_back(t);
-            }
+    // 找最低的一层, 让 timer 在这一层转一圈之内到期
+    // 用 < 而不是 <=, 差一整圈的会落到当前槽, cascade 完马上执行就提前了
+    for (unsigned level = 0; level < Levels; level++) {
+        unsigned shift = level * Bits;
+        Time diff = (t->m_expried_at >> shift) - (m_current >> shift);
+        if (diff < Time(Slots)) {
+            unsigned slot = static_cast<unsigned>(t->m_expried_at >> shift) & Mask;
+            link(m_wheel[level][slot], t, level, slot);
+            return;
+        }
+    }
+
+    // 比整个时间轮还远, 先放到最高层转一圈以后的槽里, 到时候 cascade 会再放一次
+    unsigned level = Levels - 1;
+    unsigned slot = static_cast<unsigned>(m_current >> (level * Bits)) & Mask;
+    link(m_wheel[level][slot], t, level, slot);
+}
+
+void Timer::link(Timer::List &list, Timer::Node *t, unsigned level, unsigned slot) {
+    t->m_level = level;
+    t->m_slot = slot;
+    t->m_next = nullptr;
+    t->m_prev = list.m_tail;
+    if (list.m_tail) list.m_tail->m_next = t;
+    else list.m_head = t;
+    list.m_tail = t;
+    if (level < Levels) m_occupied[level] |= uint64_t(1) << slot;
+}
+
+Timer::List &Timer::listOf(Timer::Node *t) {
+    switch (t->m_level) {
+    case DueLevel: return m_due;
+    case FiringLevel: return m_firing;
+    case RearmLevel: return m_rearm;
+    default: return m_wheel[t->m_level][t->m_slot];
+    }
+}
+
+void Timer::unlink(Timer::Node *t) {
+    List& list = listOf(t);
+    if (t->m_prev) t->m_prev->m_next = t->m_next;
+    else list.m_head = t->m_next;
+    if (t->m_next) t->m_next->m_prev = t->m_prev;
+    else list.m_tail = t->m_prev;
+    t->m_prev = t->m_next = nullptr;
+    if (t->m_level < Levels && !list.m_head) m_occupied[t->m_level] &= ~(uint64_t(1) << t->m_slot);
+    t->m_level = NoLevel;
+}
+
+Timer::List Timer::detach(Timer::List &list) {
+    List taken = list;
+    list.m_head = list.m_tail = nullptr;
+    return taken;
+}
 
+void Timer::cascade(unsigned level, unsigned slot) {
+    m_occupied[level] &= ~(uint64_t(1) << slot);
+    List list = detach(m_wheel[level][slot]);
+    unsigned current = static_cast<unsigned>(m_current) & Mask;
+    for (Node* t = list.m_head; t;) {
+        Node* next = t->m_next;
+        // 正好这一刻到期的放进第 0 层当前的槽, cascade 完马上就执行
+        if (t->m_expried_at <= m_current) link(m_wheel[0][current], t, 0, current);
+        else schedule(t);
+        t = next;
+    }
+}
+
+void Timer::fire(Timer::List &list) {
+    // 整个链表挪到 m_firing 上, 回调里 cancel 还没执行到的节点也能正常摘下来
+    m_firing = detach(list);
+    for (Node* t = m_firing.m_head; t; t = t->m_next) t->m_level = FiringLevel;
+}
+
+void Timer::run() {
+    // 一次摘一个, 回调里怎么改链表都不影响这里
+    while (Node* t = m_firing.m_head) {
+        unlink(t);
+        if (t->m_is_repeated) {
+            link(m_rearm, t, RearmLevel, 0);
+            t->m_func();
+        } else if (t->m_owned) {
+            std::unique_ptr<Node> owner(t);
+            m_timeouts.erase(t->m_id);
+            m_armed--;
+            owner->m_func();
+        } else {
+            // 回调里可能把节点销毁了, 调用之后不能再碰它
+            m_armed--;
             t->m_func();
         }
+    }
+}
 
-        for (Timeout* t : removed){
-            m_containers.erase(t->m_id);
-        }
+Timer::Time Timer::nextEvent() {
+    // 每层下一个要处理的槽: 第 0 层是到期执行, 上面几层是 cascade
+    Time best = -1;
+    for (unsigned level = 0; level < Levels; level++) {
+        if (!m_occupied[level]) continue;
+        unsigned shift = level * Bits;
+        Time base = m_current >> shift;
+        Time t = (base + distance(m_occupied[level], static_cast<unsigned>(base) & Mask)) << shift;
+        if (best < 0 || t < best) best = t;
+    }
+    return best;
+}
+
+void Timer::tick(Timer::Time time){
+    if (time < m_now) time = m_now;
+    apply(time);
+    m_now = time;
+    Time current = slotOf(time);
+
+    // 上一轮里重新排到现在的 timer 先执行, 一个 timer 一次 tick 最多执行一次
+    fire(m_due);
+    run();
+
+    // 直接跳到下一个非空的槽, 中间空的槽不用一个个走
+    while (true) {
+        Time next = nextEvent();
+        if (next < 0 || next > current) break;
+        m_current = next;
 
-        for (Timeout* t : next) {
-            m_queue.push(t);
+        for (unsigned level = Levels - 1; level > 0; level--) {
+            unsigned shift = level * Bits;
+            if (next & ((Time(1) << shift) - 1)) continue;
+            cascade(level, static_cast<unsigned>(next >> shift) & Mask);
         }
 
+        unsigned slot = static_cast<unsigned>(next) & Mask;
+        m_occupied[0] &= ~(uint64_t(1) << slot);
+        fire(m_wheel[0][slot]);
+        run();
     }
+    m_current = current;
+
+    // 重复的 timer 从这次 tick 的时间开始重新计时, 错过的不补
+    while (Node* t = m_rearm.m_head) {
+        unlink(t);
+        t->m_expried_at = deadlineOf(m_now, t->m_timeout, t->m_slack);
+        schedule(t);
+    }
+}
+
+void Timer::arm(Timer::Node &node, Timer::Time timeout, bool repeat, Timer::Time slack) {
+    if (node.m_timer && node.m_timer != this) node.cancel();
+    if (node.m_level != NoLevel) unlink(&node);
+    else m_armed++;
+    node.m_timer = this;
+    node.m_is_repeated = repeat;
+    node.m_timeout = timeout;
+    node.m_slack = slack;
+    node.m_expried_at = deadlineOf(m_now, timeout, slack);
+    schedule(&node);
+}
+
+void Timer::cancel(Timer::Node &node) {
+    if (node.m_timer != this || node.m_level == NoLevel) return;
+    unlink(&node);
+    m_armed--;
 }
 
 void Timer::clear(Timer::ID id) {
-    if (m_containers.find(id) != m_containers.end()) {
-        std::lock_guard<std::mutex> sp(m_lock);
-        m_containers[id].m_is_activated = false;
-    }
+    Command* command = new Command();
+    command->m_id = id;
+    command->m_is_cancel = true;
+    m_shards[static_cast<uint64_t>(id) % Shards].m_commands.push(command);
 }
 
 bool Timer::empty() {
-    return m_containers.empty();
+    return m_armed == 0 && !pending();
+}
+
+bool Timer::pending() {
+    for (Shard& shard : m_shards) {
+        if (!shard.m_commands.empty()) return true;
+    }
+    return false;
+}
+
+void Timer::setResolution(Timer::Time resolution) {
+    m_resolution = resolution > 0 ? resolution : 1;
+    m_current = slotOf(m_now);
+}
+
+Timer::Time Timer::resolution() const {
+    return m_resolution;
+}
+
+Timer::Time Timer::nextExpiry() {
+    if (m_due.m_head) return m_now;
+    Time next = nextEvent();
+    return next < 0 ? -1 : next * m_resolution;
 }
 
 Timer::Ref::Ref(Timer *timer, Timer::ID id)
@@ -86,19 +330,41 @@ Timer::Ref::Ref(Timer *timer, Timer::ID id)
 
 void Timer::Ref::clear(){ m_timer->clear(m_id); }
 
-Timer::Timeout::Timeout() { }
+Timer::Node::Node()
+    : Node(std::function<void()>()) { }
 
-Timer::Timeout::Timeout(Timer::ID id, Timer::Time now, bool is_repeated, Timer::Time timeout, const std::function<void ()> &func)
-    : m_id(id)
-    , m_is_activated(true)
-    , m_is_repeated(is_repeated)
-    , m_timeout(timeout)
-    , m_expried_at(now + m_timeout)
-    , m_func(func) { }
+Timer::Node::Node(const std::function<void ()> &func)
+    : m_timer(nullptr)
+    , m_id(-1)
+    , m_owned(false)
+    , m_is_repeated(false)
+    , m_timeout(0)
+    , m_slack(0)
+    , m_expried_at(0)
+    , m_func(func)
+    , m_prev(nullptr)
+    , m_next(nullptr)
+    , m_level(NoLevel)
+    , m_slot(0) { }
 
-bool Timer::Timeout::PtrLess::operator()(const Timer::Timeout *l, const Timer::Timeout *r){
-    return (l->m_expried_at > r->m_expried_at);
+Timer::Node::~Node() {
+    if (!m_owned) cancel();
 }
 
+void Timer::Node::setCallback(const std::function<void ()> &func) {
+    m_func = func;
+}
+
+bool Timer::Node::armed() const {
+    return m_level != NoLevel;
+}
+
+void Timer::Node::cancel() {
+    if (m_timer) m_timer->cancel(*this);
+}
+
+void Timer::Node::reschedule(Timer::Time timeout) {
+    if (m_timer) m_timer->arm(*this, timeout, m_is_repeated, m_slack);
+}
 
 }
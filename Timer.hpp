@@ -3,12 +3,13 @@
 #define BLXCPP_TIMER_HPP
 
 
-#include <chrono>
+#include "Clock.hpp"
+#include "MpscQueue.hpp"
+
+#include <atomic>
 #include <functional>
-#include <mutex>
-#include <map>
-#include <queue>
-#include <vector>
+#include <unordered_map>
+#include <cstdint>
 
 namespace blxcpp {
 
@@ -16,8 +17,9 @@ class Timer {
 public:
 
     using ID = int64_t;
-    using Time = int64_t;
+    using Time = int64_t; // 微秒
 
+    // 单调时钟, 见 Clock::steady
     static Time now ();
 
     class Ref {
@@ -29,41 +31,164 @@ public:
         void clear();
     };
 
-private:
+    // 侵入式的 timer 节点, 由调用方持有 (比如直接放在连接对象里), 见 Timer::arm
+    // arm / cancel / reschedule 都不分配内存, 只有构造时存回调可能分配一次
+    class Node {
+    private:
+        friend class Timer;
 
-    class Timeout {
-    public:
+        Timer* m_timer; // 最近一次 arm 到的 timer
         ID m_id;
-        bool m_is_activated;
+        bool m_owned; // setTimeout 创建的, 由 Timer 负责释放
         bool m_is_repeated; // 是否重复
         Time m_timeout; // 设置的 timeout 时间
-        Time m_expried_at; // 超时时间
+        Time m_slack; // 允许晚多少微秒触发, 见 Timer::setTimeout
+        Time m_expried_at; // 超时时间, 单位是槽, 向上取整, 所以不会提前触发
         std::function<void()> m_func; // 存储的函数
 
-        Timeout();
-        Timeout(ID id, Time now, bool is_repeated, Time timeout, const std::function<void()>& func);
-        struct PtrLess { bool operator()(const Timeout* l, const Timeout* r); };
+        // 所在槽的双向链表, 取消的时候 O(1) 摘下来
+        Node* m_prev;
+        Node* m_next;
+        unsigned m_level;
+        unsigned m_slot;
+
+    public:
+        Node();
+        explicit Node(const std::function<void()>& func);
+        // 还在 timer 里的话先摘下来
+        ~Node();
+
+        Node(const Node&) = delete;
+        Node& operator=(const Node&) = delete;
+
+        // 只能在没有 arm 的时候改
+        void setCallback(const std::function<void()>& func);
+        bool armed() const;
+
+        // 和 Timer::cancel / Timer::arm 一样, 要在 tick 的线程上调用
+        void cancel();
+        // 复用这个节点重新计时, 重复和 slack 设置不变, 从来没 arm 过的话什么都不做
+        void reschedule(Time timeout);
     };
 
 private:
-    std::mutex m_lock;
-    std::map<ID, Timeout> m_containers;
-    std::priority_queue<Timeout*, std::vector<Timeout*>, Timeout::PtrLess> m_queue;
 
-    ID m_next_id_ = 0;
-    ID nextId();
+    // 分层时间轮, 每层 64 个槽, 第 0 层一个槽是 m_resolution 微秒, 往上每层的槽宽是下一层的 64 倍
+    // 6 层能直接放下 2^36 个槽 (1ms 的时候两年多) 以内的 timer, 更远的先挂在最高层, 转到了再重新放
+    // 上层的槽转到的时候把里面的 timer 按剩余时间重新放到下层 (cascade)
+    static const unsigned Bits = 6;
+    static const unsigned Slots = 1u << Bits;
+    static const unsigned Mask = Slots - 1;
+    static const unsigned Levels = 6;
+    // 不在时间轮里的节点用 m_level 标记它挂在哪个链表上
+    static const unsigned DueLevel = Levels;        // 已经到期, 等下一次 tick 执行的
+    static const unsigned FiringLevel = Levels + 1; // 这次 tick 正在执行的
+    static const unsigned RearmLevel = Levels + 2;  // 执行过的重复 timer, tick 结束时重新计时
+    static const unsigned NoLevel = Levels + 3;     // 没有 arm
+
+    struct List {
+        Node* m_head = nullptr;
+        Node* m_tail = nullptr;
+    };
+
+    // 其他线程的 setTimeout / clear 不直接碰下面的容器, 而是推一条命令, 下次 tick 的时候统一应用
+    class Command : public MpscNode {
+    public:
+        ID m_id;
+        bool m_is_cancel;
+        bool m_is_repeated;
+        Time m_timeout;
+        Time m_slack;
+        std::function<void()> m_func;
+    };
+
+    // 命令队列按线程分片, 很多线程同时 setTimeout 的时候不会挤在同一个队列头和 id 计数器上
+    // id 的低位是分片号, clear 推到 id 所在的分片, 和对应的 set 在同一个队列里, 顺序不会乱
+    static const unsigned Shards = 16;
 
-    Time m_current;
+    struct alignas(64) Shard {
+        MpscQueue<Command> m_commands;
+        std::atomic<ID> m_next_id;
+
+        Shard()
+            : m_next_id(0) { }
+    };
+
+    static thread_local unsigned current_shard; // 当前线程用哪个分片, 第一次用到时轮流分配
+    static std::atomic<unsigned> next_shard;
+
+private:
+    Shard m_shards[Shards];
+
+    // 下面这些只在 tick 的线程上访问
+    std::unordered_map<ID, Node*> m_timeouts; // setTimeout 创建的节点
+    List m_wheel[Levels][Slots];
+    uint64_t m_occupied[Levels]; // 每层哪些槽不是空的
+    List m_due;
+    // 回调里可以 cancel / arm 任何节点, 所以正在执行的和等着重新计时的也要挂在成员上, 不能是局部变量
+    List m_firing;
+    List m_rearm;
+    size_t m_armed; // 所有 arm 着的节点, 包括侵入式的
+    Time m_resolution; // 第 0 层一个槽多少微秒
+    Time m_now;        // 上一次 tick 的时间
+    Time m_current;    // m_now 所在的槽
+
+    Time slotOf(Time time) const;
+    Time deadlineOf(Time time, Time timeout, Time slack) const;
+    static unsigned shardIndex();
+    void apply(Time time);
+    void schedule(Node* t);
+    List& listOf(Node* t);
+    void link(List& list, Node* t, unsigned level, unsigned slot);
+    void unlink(Node* t);
+    List detach(List& list);
+    void fire(List& list);
+    void cascade(unsigned level, unsigned slot);
+    void run();
+    Time nextEvent();
 
 public:
 
-    Timer(Time current);
+    // resolution 是第 0 层一个槽的宽度 (微秒), 到期时间按它向上取整
+    // 越小越精确, 但是同样的层数能放下的时间范围也越短
+    Timer(Time current, Time resolution = 1000);
     Timer();
-    Ref setTimeout(Time timeout, bool repeat, const std::function<void()>& func);
+    ~Timer();
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+    // setTimeout 和 clear 可以在任意线程上调用, 无锁, 每个线程推到自己的分片, 到下一次 tick 才真正生效
+    // tick / empty / pending / nextExpiry 只能在 tick 的那个线程上调用
+    // 应用之后 arm / clear 都是 O(1), tick 只看非空的槽, 和 timer 总数无关
+    // slack 和 linux 的 timerslack 一样, 允许 timer 最多晚 slack 微秒触发:
+    // 到期时间会在 [timeout, timeout + slack] 里挑一个尽量整的时刻, 时间差不多的 timer 就落到同一个槽里一起触发
+    Ref setTimeout(Time timeout, bool repeat, const std::function<void()>& func, Time slack = 0);
     void tick(Time time);
+    // 从哪个线程 clear 都一样, 命令推到 id 所在的分片, tick 先应用命令再执行到期的 timer:
+    // 在某次 tick 之前推进去的 clear, 哪怕那次 tick 的时候 timer 已经到期, 也不会再触发 (按取消算)
+    // 已经触发过的不重复的 timer, clear 什么都不做; 重复的 timer 从下一次 tick 开始不再触发
+    // 和正在进行的 tick 同时推的 clear 赶上哪次 tick 算哪次, 所以调用方只能靠 clear 和 tick 之间的先后关系判断
     void clear(ID id);
     bool empty();
 
+    // 侵入式节点的接口, 只能在 tick 的那个线程上调用 (包括 timer 回调里), 都是 O(1)
+    // 时间从上一次 tick 开始算; 节点已经 arm 了的话先摘下来再重新计时
+    // 回调直接在 tick 里执行, 回调里可以 cancel / arm 任何节点, 也可以销毁自己的节点
+    void arm(Node& node, Time timeout, bool repeat = false, Time slack = 0);
+    void cancel(Node& node);
+
+    // 只能在还没有 timer 的时候改
+    void setResolution(Time resolution);
+    Time resolution() const;
+
+    // 还有没应用的命令, 调用方应该尽快再 tick 一次
+    bool pending();
+
+    // 最早的到期时间, 没有 timer 的时候返回 -1
+    // 只是用来决定事件循环最多睡多久, 比较远的 timer 只精确到所在的槽, 可能会让它提前醒一次
+    Time nextExpiry();
+
 };
 
 }
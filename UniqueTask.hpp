@@ -0,0 +1,137 @@
+// UniqueTask.hpp
+#ifndef BLXCPP_UNIQUETASK_HPP
+#define BLXCPP_UNIQUETASK_HPP
+
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#include <functional>
+
+namespace blxcpp {
+
+// 只能移动的 void() 可调用对象, 用来代替 std::function<void()>
+// 不超过 InlineSize 的函数对象直接放在内部 buffer 里, 不会碰分配器
+// 太大的或者移动可能抛异常的才退化成堆上分配
+class UniqueTask {
+public:
+    static const size_t InlineSize = 64;
+
+private:
+    using Storage = typename std::aligned_storage<InlineSize, alignof(std::max_align_t)>::type;
+
+    // 手写的 "虚表", 每种函数对象类型一份
+    struct Ops {
+        void (*invoke)(Storage* storage);
+        void (*relocate)(Storage* dst, Storage* src); // 移动到 dst 并析构 src
+        void (*destroy)(Storage* storage);
+    };
+
+    template<typename F>
+    struct IsInline {
+        static const bool value = sizeof(F) <= InlineSize
+                && alignof(F) <= alignof(Storage)
+                && std::is_nothrow_move_constructible<F>::value;
+    };
+
+    template<typename F, bool Inline = IsInline<F>::value>
+    struct Manager;
+
+    template<typename F>
+    struct Manager<F, true> {
+        static F* get(Storage* s) { return reinterpret_cast<F*>(s); }
+
+        template<typename U>
+        static void create(Storage* s, U&& func) { new (s) F(std::forward<U>(func)); }
+
+        static void invoke(Storage* s) { (*get(s))(); }
+        static void relocate(Storage* dst, Storage* src) {
+            new (dst) F(std::move(*get(src)));
+            get(src)->~F();
+        }
+        static void destroy(Storage* s) { get(s)->~F(); }
+
+        static const Ops ops;
+    };
+
+    template<typename F>
+    struct Manager<F, false> {
+        static F*& get(Storage* s) { return *reinterpret_cast<F**>(s); }
+
+        template<typename U>
+        static void create(Storage* s, U&& func) { new (s) F*(new F(std::forward<U>(func))); }
+
+        static void invoke(Storage* s) { (*get(s))(); }
+        static void relocate(Storage* dst, Storage* src) { new (dst) F*(get(src)); }
+        static void destroy(Storage* s) { delete get(s); }
+
+        static const Ops ops;
+    };
+
+    const Ops* m_ops;
+    Storage m_storage;
+
+    void reset() {
+        if (m_ops != nullptr) {
+            m_ops->destroy(&m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+public:
+
+    UniqueTask() noexcept
+        : m_ops(nullptr) { }
+
+    template<typename Func, typename F = typename std::decay<Func>::type,
+             typename = typename std::enable_if<!std::is_same<F, UniqueTask>::value>::type>
+    UniqueTask(Func&& func)
+        : m_ops(&Manager<F>::ops) {
+        Manager<F>::create(&m_storage, std::forward<Func>(func));
+    }
+
+    UniqueTask(UniqueTask&& other) noexcept
+        : m_ops(other.m_ops) {
+        if (m_ops != nullptr) {
+            m_ops->relocate(&m_storage, &other.m_storage);
+            other.m_ops = nullptr;
+        }
+    }
+
+    UniqueTask& operator=(UniqueTask&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.m_ops != nullptr) {
+                m_ops = other.m_ops;
+                m_ops->relocate(&m_storage, &other.m_storage);
+                other.m_ops = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    UniqueTask(const UniqueTask&) = delete;
+    UniqueTask& operator=(const UniqueTask&) = delete;
+
+    ~UniqueTask() { reset(); }
+
+    explicit operator bool() const { return m_ops != nullptr; }
+
+    void operator()() {
+        if (m_ops == nullptr) throw std::bad_function_call();
+        m_ops->invoke(&m_storage);
+    }
+};
+
+template<typename F>
+const UniqueTask::Ops UniqueTask::Manager<F, true>::ops = {
+    &Manager<F, true>::invoke, &Manager<F, true>::relocate, &Manager<F, true>::destroy
+};
+
+template<typename F>
+const UniqueTask::Ops UniqueTask::Manager<F, false>::ops = {
+    &Manager<F, false>::invoke, &Manager<F, false>::relocate, &Manager<F, false>::destroy
+};
+
+}
+
+#endif // BLXCPP_UNIQUETASK_HPP
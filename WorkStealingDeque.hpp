@@ -0,0 +1,129 @@
+// WorkStealingDeque.hpp
+#ifndef BLXCPP_WORKSTEALINGDEQUE_HPP
+#define BLXCPP_WORKSTEALINGDEQUE_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace blxcpp {
+
+// Chase-Lev 无锁双端队列 (按 Lê et al. 2013 的 C11 内存序版本实现)
+// 只有 owner 线程能 push / pop (栈顶, LIFO, 缓存友好)
+// 其他线程只能 steal (栈底, FIFO)
+// 队列里只存指针, 元素的生命周期由使用者自己管理
+template <typename T>
+class WorkStealingDeque {
+private:
+
+    class Array {
+    public:
+        const int64_t m_capacity;
+        const int64_t m_mask;
+        std::unique_ptr<std::atomic<T*>[]> m_data;
+
+        explicit Array(int64_t capacity)
+            : m_capacity(capacity)
+            , m_mask(capacity - 1)
+            , m_data(new std::atomic<T*>[static_cast<size_t>(capacity)]) { }
+
+        T* get(int64_t i) const { return m_data[i & m_mask].load(std::memory_order_relaxed); }
+        void put(int64_t i, T* x) { m_data[i & m_mask].store(x, std::memory_order_relaxed); }
+
+        Array* grow(int64_t bottom, int64_t top) const {
+            Array* array = new Array(m_capacity * 2);
+            for (int64_t i = top; i < bottom; i++) array->put(i, get(i));
+            return array;
+        }
+    };
+
+    std::atomic<int64_t> m_top;
+    std::atomic<int64_t> m_bottom;
+    std::atomic<Array*> m_array;
+
+    // 扩容后旧数组可能还在被 stealer 读, 所以留到析构时再释放
+    std::vector<std::unique_ptr<Array>> m_garbage;
+
+public:
+
+    explicit WorkStealingDeque(int64_t capacity = 256)
+        : m_top(0), m_bottom(0), m_array(new Array(capacity)) {
+        m_garbage.emplace_back(m_array.load(std::memory_order_relaxed));
+    }
+
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // owner only
+    void push(T* x) {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Array* a = m_array.load(std::memory_order_relaxed);
+        if (b - t > a->m_capacity - 1) {
+            a = a->grow(b, t);
+            m_garbage.emplace_back(a);
+            m_array.store(a, std::memory_order_release);
+        }
+        a->put(b, x);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // owner only, 空的时候返回 nullptr
+    T* pop() {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Array* a = m_array.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        T* x = nullptr;
+        if (t <= b) {
+            x = a->get(b);
+            if (t == b) {
+                // 只剩最后一个元素了, 要和 stealer 抢
+                if (!m_top.compare_exchange_strong(t, t + 1,
+                        std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    x = nullptr;
+                }
+                m_bottom.store(b + 1, std::memory_order_relaxed);
+            }
+        } else {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return x;
+    }
+
+    // 任意线程, 失败 (为空或者抢输了) 返回 nullptr
+    T* steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+
+        T* x = nullptr;
+        if (t < b) {
+            Array* a = m_array.load(std::memory_order_acquire);
+            x = a->get(t);
+            if (!m_top.compare_exchange_strong(t, t + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+        }
+        return x;
+    }
+
+    // 只是个快照, 并发情况下不精确
+    size_t size() const {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? static_cast<size_t>(b - t) : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+};
+
+}
+
+#endif // BLXCPP_WORKSTEALINGDEQUE_HPP
@@ -0,0 +1,96 @@
+// bench/AsyncPayload.cpp
+// 不同大小的 buffer 经过 async 往返 (回调和 co_await Call 两条路), 移动传递和拷贝传递对比每次调用的耗时
+// 拷贝: 调用者留着自己的 buffer, 参数拷进去, 结果再拷一份出来; 移动: 参数和结果都一路移动
+// g++ -std=c++20 -O2 -I.. AsyncPayload.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+#include "Coroutine.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace blxcpp;
+
+using Buffer = std::vector<char>;
+using Wall = std::chrono::steady_clock;
+
+static double nanos(Wall::time_point from, Wall::time_point to) {
+    return std::chrono::duration<double, std::nano>(to - from).count();
+}
+
+// 一批投 Batch 个, 跑完再投下一批; 移动那边回调把 buffer 放回原处, 下一批接着用, 不重新分配
+static const int Batch = 64;
+
+static double callbacks(AsyncEventLoop& loop, size_t size, int calls, bool move) {
+    auto echo = loop.async([](Buffer data) {
+        data[0]++;
+        return data;
+    });
+    std::vector<Buffer> buffers(Batch, Buffer(size, 'x'));
+    size_t total = 0;
+
+    auto start = Wall::now();
+    for (int i = 0; i < calls; i += Batch) {
+        for (int j = 0; j < Batch; j++) {
+            Buffer& slot = buffers[j];
+            if (move) {
+                echo(std::move(slot), [&total, &slot](Buffer&& result) {
+                    slot = std::move(result);
+                    total += slot.size();
+                });
+            } else {
+                echo(slot, [&total](Buffer&& result) {
+                    Buffer kept(result);
+                    total += kept.size();
+                });
+            }
+        }
+        loop.epoll();
+    }
+    auto stop = Wall::now();
+
+    int done = (calls + Batch - 1) / Batch * Batch;
+    return total == size * done ? nanos(start, stop) / done : -1;
+}
+
+static CoTask<void> roundTrips(AsyncEventLoop& loop, size_t size, int calls, bool move, size_t& total) {
+    auto echo = loop.async([](Buffer data) {
+        data[0]++;
+        return data;
+    });
+    Buffer buffer(size, 'x');
+    for (int i = 0; i < calls; i++) {
+        if (move) {
+            buffer = co_await echo(std::move(buffer));
+        } else {
+            Buffer result = co_await echo(buffer);
+            Buffer kept(result);
+            buffer.swap(kept);
+        }
+        total += buffer.size();
+    }
+}
+
+// 一个协程里一次一个地 co_await, 测的是单次往返
+static double awaits(AsyncEventLoop& loop, size_t size, int calls, bool move) {
+    size_t total = 0;
+    auto start = Wall::now();
+    roundTrips(loop, size, calls, move, total).start();
+    loop.epoll();
+    auto stop = Wall::now();
+    return total == size * calls ? nanos(start, stop) / calls : -1;
+}
+
+int main(int argc, char** argv) {
+    const int calls = argc > 1 ? std::atoi(argv[1]) : 20000;
+    AsyncEventLoop loop(1);
+
+    std::printf("%8s %14s %14s %14s %14s\n", "bytes", "callback copy", "callback move", "await copy", "await move");
+    for (size_t size : { 16, 256, 1024, 4096, 8192, 65536 }) {
+        std::printf("%8zu %11.0f ns %11.0f ns %11.0f ns %11.0f ns\n", size,
+                    callbacks(loop, size, calls, false), callbacks(loop, size, calls, true),
+                    awaits(loop, size, calls, false), awaits(loop, size, calls, true));
+    }
+    return 0;
+}
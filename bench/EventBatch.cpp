@@ -0,0 +1,96 @@
+// bench/EventBatch.cpp
+// 1 / 4 / 16 个线程往事件循环里 pushEvent, 统计每秒执行多少个事件
+// mutex 是照着以前的事件循环写的对照组: 一把锁保护 std::deque<std::function>, 每轮先 tick 一个空的 timer
+// (读一次 system_clock, 拿一次 timer 的锁), 再拿队列锁只取一个; 以前每个事件之后还 sleep interval 毫秒, 这里去掉了
+// 其余是现在的无锁队列, budget 是每轮最多执行几个事件: 1 每轮一个, 256 是默认值, 0 表示不限
+// g++ -std=c++20 -O2 -I.. EventBatch.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace blxcpp;
+
+// 以前的做法: 生产者拿锁 push_back, 事件循环每轮拿锁取一个, 空的时候直接进下一轮
+static double mutexQueue(int producers, long per_producer) {
+    std::mutex timer_lock;
+    int64_t timer_now = 0;
+    std::mutex lock;
+    std::deque<std::function<void()>> queue;
+    const long total = producers * per_producer;
+    long done = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&lock, &queue, &done, per_producer](){
+            for (long i = 0; i < per_producer; i++) {
+                std::lock_guard<std::mutex> sp(lock);
+                queue.push_back([&done](){ ++done; });
+            }
+        });
+    }
+    while (done < total) {
+        {
+            std::lock_guard<std::mutex> sp(timer_lock);
+            timer_now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+        }
+        std::function<void()> event;
+        {
+            std::lock_guard<std::mutex> sp(lock);
+            if (queue.empty()) continue;
+            event = queue.front();
+            queue.pop_front();
+        }
+        event();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    for (auto& thread : threads) thread.join();
+    return timer_now > 0 ? total / std::chrono::duration<double>(stop - start).count() : 0;
+}
+
+static double lockFree(int producers, size_t budget, long per_producer) {
+    AsyncEventLoop loop(1);
+    loop.setBudget(budget);
+    const long total = producers * per_producer;
+    long done = 0;
+
+    // 生产者还没开始投的时候事件循环也不能退出
+    loop.ref();
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; p++) {
+        threads.emplace_back([&loop, &done, total, per_producer](){
+            for (long i = 0; i < per_producer; i++) {
+                loop.pushEvent([&loop, &done, total](){
+                    if (++done == total) loop.unref();
+                });
+            }
+        });
+    }
+    loop.epoll();
+    auto stop = std::chrono::steady_clock::now();
+    for (auto& thread : threads) thread.join();
+
+    return total / std::chrono::duration<double>(stop - start).count();
+}
+
+int main(int argc, char** argv) {
+    const long events = argc > 1 ? std::atol(argv[1]) : 1 << 20;
+    std::printf("%9s %10s %14s %16s %16s\n", "producers", "mutex", "lock-free b=1", "lock-free b=256", "lock-free b=0");
+    for (int producers : { 1, 4, 16 }) {
+        long per_producer = events / producers;
+        std::printf("%9d %8.2f M %12.2f M %14.2f M %14.2f M  events/s\n", producers,
+                    mutexQueue(producers, per_producer) / 1e6, lockFree(producers, 1, per_producer) / 1e6,
+                    lockFree(producers, 256, per_producer) / 1e6, lockFree(producers, 0, per_producer) / 1e6);
+    }
+    return 0;
+}
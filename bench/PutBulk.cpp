@@ -0,0 +1,45 @@
+// bench/PutBulk.cpp
+// 一批一批投小任务, 逐个 put 和 put_bulk 对比每个任务的耗时和发出的唤醒次数
+// 每批投完等池子空下来, 让下一批开始时 worker 都在睡
+// g++ -std=c++20 -O2 -I.. PutBulk.cpp ../ThreadPool.cpp ../Numa.cpp -lpthread
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace blxcpp;
+
+template<typename Submit>
+static void measure(const char* name, size_t batch, int total, Submit submit) {
+    ThreadPool pool(4);
+    std::atomic<long> done(0);
+    uint64_t before = pool.counters().wakeups;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < total; i += batch) {
+        submit(pool, done, batch);
+        pool.wait_idle();
+    }
+    auto stop = std::chrono::steady_clock::now();
+    uint64_t wakeups = pool.counters().wakeups - before;
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / total;
+    std::printf("batch %4zu %-9s %8.1f ns/task %8.3f wakeups/task\n", batch, name, ns, double(wakeups) / total);
+}
+
+int main(int argc, char** argv) {
+    const int total = argc > 1 ? std::atoi(argv[1]) : 1 << 18;
+    for (size_t batch : { 1, 16, 256, 4096 }) {
+        measure("put", batch, total, [](ThreadPool& pool, std::atomic<long>& done, size_t count) {
+            for (size_t i = 0; i < count; i++) pool.put([&done](){ done++; });
+        });
+        measure("put_bulk", batch, total, [](ThreadPool& pool, std::atomic<long>& done, size_t count) {
+            std::vector<ThreadPool::Task> tasks;
+            tasks.reserve(count);
+            for (size_t i = 0; i < count; i++) tasks.emplace_back([&done](){ done++; });
+            pool.put_bulk(std::move(tasks));
+        });
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+// bench/TaskAlloc.cpp
+// 每个任务分配几次内存, 每个任务多少 ns: 直接 put lambda, put std::function, 以及以前 create 套两层 std::function 的做法
+// 热身以后直接 put lambda 应该是 0 次, 不是的话返回 1
+// g++ -std=c++20 -O2 -I.. TaskAlloc.cpp ../ThreadPool.cpp ../Numa.cpp -lpthread
+#include "ThreadPool.hpp"
+#include "Latch.hpp"
+#include "tests/AllocCounter.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace blxcpp;
+
+template<typename Submit>
+static long measure(const char* name, ThreadPool& pool, int tasks, Submit submit) {
+    long before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < tasks; i++) submit(i);
+    pool.wait_idle();
+    auto stop = std::chrono::steady_clock::now();
+    long used = allocations.load() - before;
+    double ns = std::chrono::duration<double, std::nano>(stop - start).count() / tasks;
+    std::printf("%-24s %6.2f allocs/task %8.1f ns/task\n", name, double(used) / tasks, ns);
+    return used;
+}
+
+int main(int argc, char** argv) {
+    const int tasks = argc > 1 ? std::atoi(argv[1]) : 200000;
+    ThreadPool pool(1);
+    std::atomic<long> sum(0);
+
+    // 热身: 卡住唯一的 worker 投满一轮, 把队列撑到一轮的长度, 之后测的就是稳定状态
+    Latch release(1);
+    pool.put([&release](){ release.wait(); });
+    for (int i = 0; i < tasks; i++) pool.put([&sum](){ sum.fetch_add(1, std::memory_order_relaxed); });
+    release.count_down();
+    pool.wait_idle();
+
+    // 捕获 24 字节, 超过 std::function 的内联缓冲, 在 UniqueTask 的 64 字节以内
+    long steady = measure("put(lambda)", pool, tasks, [&pool, &sum](int i) {
+        long a = i, b = i;
+        pool.put([&sum, a, b](){ sum.fetch_add(a + b, std::memory_order_relaxed); });
+    });
+    measure("put(std::function)", pool, tasks, [&pool, &sum](int i) {
+        long a = i, b = i;
+        pool.put(ThreadPool::Task([&sum, a, b](){ sum.fetch_add(a + b, std::memory_order_relaxed); }));
+    });
+    // 以前的路径: put(const Task&) 里 create 把 Task 拷进一个 std::function<bool()> 再进队列
+    measure("Task + create wrapper", pool, tasks, [&pool, &sum](int i) {
+        long a = i, b = i;
+        ThreadPool::Task task([&sum, a, b](){ sum.fetch_add(a + b, std::memory_order_relaxed); });
+        std::function<bool()> wrapped([task](){ task(); return true; });
+        pool.put([wrapped = std::move(wrapped)](){ wrapped(); });
+    });
+    // 稳定状态下直接 put lambda 一次都不应该分配
+    if (steady != 0) std::printf("put(lambda) allocated in steady state: FAILED\n");
+    return steady == 0 && sum.load() != 0 ? 0 : 1;
+}
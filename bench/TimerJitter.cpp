@@ -0,0 +1,50 @@
+// bench/TimerJitter.cpp
+// 在事件循环上一个接一个地设 timer, 统计实际触发时间比截止时间晚了多少微秒
+// 负数说明提前触发了, 不应该出现
+// g++ -std=c++20 -O2 -I.. TimerJitter.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+
+using namespace blxcpp;
+
+static void run(Timer::Time resolution, Timer::Time delay, AsyncEventLoop::TimeSource source, bool cached, int samples) {
+    AsyncEventLoop loop(1);
+    loop.setTimerResolution(resolution);
+    loop.setTimeSource(source, cached);
+    std::vector<Timer::Time> late;
+    late.reserve(samples);
+
+    std::function<void()> arm = [&](){
+        Timer::Time start = Clock::steady();
+        loop.setTimeoutMicros(delay, [&, start](){
+            late.push_back(Clock::steady() - start - delay);
+            if (static_cast<int>(late.size()) < samples) arm();
+        });
+    };
+    arm();
+    loop.epoll();
+
+    std::sort(late.begin(), late.end());
+    auto at = [&late](size_t permille) { return late[std::min(late.size() - 1, late.size() * permille / 1000)]; };
+    std::printf("resolution %4ld us delay %5ld us %-6s %-6s: min %5ld p50 %5ld p90 %5ld p99 %5ld p99.9 %5ld max %5ld us\n",
+                static_cast<long>(resolution), static_cast<long>(delay),
+                source == AsyncEventLoop::TimeSource::Tsc ? "tsc" : "steady", cached ? "cached" : "live",
+                static_cast<long>(late.front()), static_cast<long>(at(500)), static_cast<long>(at(900)),
+                static_cast<long>(at(990)), static_cast<long>(at(999)), static_cast<long>(late.back()));
+}
+
+int main(int argc, char** argv) {
+    const int samples = argc > 1 ? std::atoi(argv[1]) : 2000;
+    run(1000, 2000, AsyncEventLoop::TimeSource::Steady, false, samples);
+    run(100, 1000, AsyncEventLoop::TimeSource::Steady, false, samples);
+    run(50, 500, AsyncEventLoop::TimeSource::Steady, false, samples);
+    run(50, 500, AsyncEventLoop::TimeSource::Steady, true, samples);
+    run(50, 500, AsyncEventLoop::TimeSource::Tsc, true, samples);
+    std::printf("invariant tsc: %s\n", Clock::hasTsc() ? "yes" : "no");
+    return 0;
+}
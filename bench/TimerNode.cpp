@@ -0,0 +1,45 @@
+// bench/TimerNode.cpp
+// 每个请求设一个超时, 几乎总是在超时之前取消: setTimeout + clear 和嵌入式 Timer::Node 的 arm + cancel 对比
+// g++ -std=c++20 -O2 -I.. TimerNode.cpp ../Timer.cpp ../Clock.cpp -lpthread
+#include "Timer.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace blxcpp;
+
+using Wall = std::chrono::steady_clock;
+
+static double nanos(Wall::time_point from, Wall::time_point to) {
+    return std::chrono::duration<double, std::nano>(to - from).count();
+}
+
+int main(int argc, char** argv) {
+    const int requests = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const Timer::Time timeout = 30000000;
+    Timer timer(0);
+    Timer::Time now = 0;
+
+    // 每 256 个请求 tick 一次, 和事件循环里一样让排队的命令被处理掉
+    auto start = Wall::now();
+    for (int i = 0; i < requests; i++) {
+        Timer::Ref ref = timer.setTimeout(timeout, false, [](){ });
+        ref.clear();
+        if (i % 256 == 0) timer.tick(++now);
+    }
+    timer.tick(++now);
+    auto middle = Wall::now();
+
+    Timer::Node node([](){ });
+    for (int i = 0; i < requests; i++) {
+        timer.arm(node, timeout);
+        node.cancel();
+        if (i % 256 == 0) timer.tick(++now);
+    }
+    auto stop = Wall::now();
+
+    std::printf("setTimeout + clear %6.1f ns/request\n", nanos(start, middle) / requests);
+    std::printf("Node arm + cancel  %6.1f ns/request\n", nanos(middle, stop) / requests);
+    return 0;
+}
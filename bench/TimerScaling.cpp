@@ -0,0 +1,51 @@
+// bench/TimerScaling.cpp
+// 1 到 32 个线程同时 setTimeout, 一半马上 clear, 另一个线程一直 tick
+// 只统计吞吐: 每秒能 arm 多少个, 以及 worker 停下以后 tick 线程还要多久才把命令和 timer 清完
+// 对不对交给 tests/TimerStress.cpp 和 tests/TimerDueCancel.cpp
+// g++ -std=c++20 -O2 -I.. TimerScaling.cpp ../Timer.cpp ../Clock.cpp -lpthread
+#include "Timer.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace blxcpp;
+
+int main(int argc, char** argv) {
+    const int per_thread = argc > 1 ? std::atoi(argv[1]) : 200000;
+
+    for (int threads : { 1, 2, 4, 8, 16, 32 }) {
+        Timer timer(0);
+        std::atomic<bool> done(false);
+
+        std::thread ticker([&timer, &done](){
+            Timer::Time now = 0;
+            while (!done.load() || !timer.empty()) timer.tick(now += 1000);
+        });
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int w = 0; w < threads; w++) {
+            workers.emplace_back([&timer, per_thread](){
+                for (int i = 0; i < per_thread; i++) {
+                    Timer::Ref ref = timer.setTimeout(5000, false, [](){ });
+                    if (i % 2) ref.clear();
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+        auto stop = std::chrono::steady_clock::now();
+        done = true;
+        ticker.join();
+        auto drained = std::chrono::steady_clock::now();
+
+        double seconds = std::chrono::duration<double>(stop - start).count();
+        double drain = std::chrono::duration<double, std::milli>(drained - stop).count();
+        std::printf("%2d threads: %5.2f M arms/s, drain %7.2f ms\n",
+                    threads, threads * per_thread / seconds / 1e6, drain);
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+// bench/TimerSlack.cpp
+// 20000 个 1 秒的心跳在第一秒里错开启动, 每毫秒 tick 一次跑 10 秒
+// 统计不同 slack 下有多少个不同的唤醒时刻, 以及有没有心跳落在 [截止时间, 截止时间 + slack] 之外
+// g++ -std=c++20 -O2 -I.. TimerSlack.cpp ../Timer.cpp ../Clock.cpp -lpthread
+#include "Timer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace blxcpp;
+
+int main() {
+    const int heartbeats = 20000;
+    const Timer::Time period = 1000000;
+    const Timer::Time step = 1000;
+    const Timer::Time duration = 10000000;
+
+    for (Timer::Time slack : { 0, 1000, 10000, 50000 }) {
+        std::mt19937 rng(5);
+        std::vector<Timer::Time> starts;
+        for (int i = 0; i < heartbeats; i++) starts.push_back((rng() % 1000) * step);
+        std::sort(starts.begin(), starts.end());
+
+        Timer timer(0);
+        Timer::Time now = 0;
+        std::set<Timer::Time> wakeups;
+        long fired = 0;
+        long outside = 0;
+
+        size_t next = 0;
+        for (now = 0; now <= duration; now += step) {
+            for (; next < starts.size() && starts[next] <= now; next++) {
+                Timer::Time last = now;
+                timer.setTimeout(period, true, [&, last]() mutable {
+                    fired++;
+                    if (now < last + period || now > last + period + slack) outside++;
+                    wakeups.insert(now);
+                    last = now;
+                }, slack);
+            }
+            timer.tick(now);
+        }
+
+        std::printf("slack %6ld us: fired %ld, distinct wakeups %zu, outside window %ld\n",
+                    static_cast<long>(slack), fired, wakeups.size(), outside);
+    }
+    return 0;
+}
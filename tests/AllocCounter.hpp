@@ -0,0 +1,22 @@
+// tests/AllocCounter.hpp
+// 替换全局 operator new, 数这个进程里一共分配了几次
+// 定义的是全局函数, 一个程序只能有一个 .cpp 包含它
+#ifndef BLXCPP_TESTS_ALLOCCOUNTER_HPP
+#define BLXCPP_TESTS_ALLOCCOUNTER_HPP
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<long> allocations(0);
+
+void* operator new(size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+#endif // BLXCPP_TESTS_ALLOCCOUNTER_HPP
@@ -0,0 +1,69 @@
+// tests/AsyncMove.cpp
+// Async 的参数和结果从调用者一路移动到回调, 一次都不拷贝; 只能移动的参数也要能传
+// 参数是 T& 的函数也要能用, 拿到的是 Async 自己存的那一份
+// g++ -std=c++20 -O2 -I.. AsyncMove.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace blxcpp;
+
+static std::atomic<int> copies(0);
+
+// 能拷贝但是数着拷贝次数的大块数据
+struct Payload {
+    std::vector<char> m_data;
+
+    explicit Payload(size_t size) : m_data(size, 'x') { }
+    Payload(const Payload& other) : m_data(other.m_data) { copies++; }
+    Payload(Payload&& other) = default;
+    Payload& operator=(const Payload& other) { m_data = other.m_data; copies++; return *this; }
+    Payload& operator=(Payload&& other) = default;
+};
+
+int main() {
+    const int rounds = 100;
+    AsyncEventLoop loop(2);
+    size_t received = 0;
+    int moved = 0;
+    int edited = 0;
+
+    auto grow = loop.async([](Payload payload) {
+        payload.m_data.push_back('y');
+        return payload;
+    });
+    auto own = loop.async([](std::unique_ptr<int> value) {
+        (*value)++;
+        return value;
+    });
+    auto edit = loop.async([](std::string& text) {
+        text += "!";
+        return text;
+    });
+
+    for (int i = 0; i < rounds; i++) {
+        grow(Payload(1 << 20), [&received](Payload&& payload) {
+            Payload kept(std::move(payload));
+            received += kept.m_data.size();
+        });
+        own(std::make_unique<int>(i), [&moved, i](std::unique_ptr<int>&& value) {
+            if (value && *value == i + 1) moved++;
+        });
+        std::string text("hi");
+        edit(text, [&edited](std::string&& result) {
+            if (result == "hi!") edited++;
+        });
+        // 不 co_await 的 Call 析构时投递, 走的也是同一个 apply
+        edit(text);
+        if (text != "hi") edited = -rounds;
+    }
+    loop.epoll();
+
+    bool ok = copies.load() == 0 && received == rounds * ((1 << 20) + 1) && moved == rounds && edited == rounds;
+    std::printf("copies %d received %zu moved %d edited %d: %s\n", copies.load(), received, moved, edited, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,52 @@
+// tests/LocalAlloc.cpp
+// work stealing 模式下 worker 里投的小任务, 热身之后不应该再碰分配器
+// g++ -std=c++20 -O2 -I.. LocalAlloc.cpp ../ThreadPool.cpp ../Numa.cpp -lpthread
+#include "ThreadPool.hpp"
+#include "Latch.hpp"
+#include "AllocCounter.hpp"
+
+#include <atomic>
+#include <cstdio>
+
+using namespace blxcpp;
+
+int main() {
+    const int tasks = 10000;
+    const int workers = 4;
+    ThreadPool pool(workers, ThreadPool::Mode::WorkStealing);
+    std::atomic<int> done(0);
+
+    // 从 worker 里投一轮短任务, 一部分会被别的 worker 偷走
+    auto round = [&pool, &done, tasks](){
+        pool.put([&pool, &done, tasks](){
+            for (int i = 0; i < tasks; i++) pool.put([&done](){ done.fetch_add(1, std::memory_order_relaxed); });
+        });
+        pool.wait_idle();
+    };
+
+    // 热身: 节点还给分配它的 worker, 所以要让每个 worker 都在没人偷的情况下投一整轮, 攒够最坏情况要的节点
+    // 每个 worker 上各卡一个任务, 都到齐以后一起投, 都投完才放开, 投的时候没有空闲的 worker 来偷
+    Latch started(workers);
+    Latch pushed(workers);
+    for (int w = 0; w < workers; w++) {
+        pool.put([&pool, &done, &started, &pushed, tasks](){
+            started.count_down();
+            started.wait();
+            for (int i = 0; i < tasks; i++) pool.put([&done](){ done.fetch_add(1, std::memory_order_relaxed); });
+            pushed.count_down();
+            pushed.wait();
+        });
+    }
+    pool.wait_idle();
+    round();
+
+    const int rounds = 20;
+    done = 0;
+    long before = allocations.load();
+    for (int i = 0; i < rounds; i++) round();
+    long used = allocations.load() - before;
+
+    bool ok = done.load() == tasks * rounds && used == 0;
+    std::printf("%d local tasks, %ld allocations: %s\n", tasks * rounds, used, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,49 @@
+// tests/LoopAffinity.cpp
+// 事件循环启动之前和停止之后, 线程池里的任务调用 pushNextTick / readAsync 要走事件队列,
+// 不能和 owner 线程同时改 m_next_ticks 和 io_uring, 用 -fsanitize=thread 编译跑
+// g++ -std=c++20 -O1 -g -fsanitize=thread -I.. LoopAffinity.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
+
+using namespace blxcpp;
+
+int main() {
+    const int rounds = 2000;
+    AsyncEventLoop loop(4);
+    std::atomic<int> ticks(0);
+    std::atomic<int> reads(0);
+
+    int fds[2];
+    if (pipe(fds) != 0) return 1;
+    static char out[rounds];
+    static char in[rounds];
+    if (write(fds[1], out, sizeof (out)) != rounds) return 1;
+
+    // 事件循环还没启动, 线程池和主线程同时投
+    ThreadPool pool(4);
+    for (int i = 0; i < rounds; i++) {
+        pool.put([&loop, &ticks, &reads, i, fd = fds[0]](){
+            loop.pushNextTick(AsyncEventLoop::Event([&ticks](){ ticks++; }));
+            loop.readAsync(fd, &in[i], 1, -1, [&reads](int res){ if (res == 1) reads++; });
+        });
+        loop.pushNextTick(AsyncEventLoop::Event([&ticks](){ ticks++; }));
+    }
+    pool.wait_idle();
+    loop.epoll();
+
+    // 事件循环停了以后再从线程池里投, 下一次 epoll 才执行
+    pool.put([&loop, &ticks](){ loop.pushNextTick(AsyncEventLoop::Event([&ticks](){ ticks++; })); });
+    loop.pushNextTick(AsyncEventLoop::Event([&ticks](){ ticks++; }));
+    pool.wait_idle();
+    loop.epoll();
+
+    close(fds[0]);
+    close(fds[1]);
+
+    bool ok = ticks.load() == rounds * 2 + 2 && reads.load() == rounds;
+    std::printf("ticks %d reads %d: %s\n", ticks.load(), reads.load(), ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
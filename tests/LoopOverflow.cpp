@@ -0,0 +1,86 @@
+// tests/LoopOverflow.cpp
+// DropOldest 的时候事件循环卡在一个长事件里, 其他线程一直 pushEvent, 队列不能无限涨, 留下来的要是最新的
+// 事件循环没在跑的时候投过两倍容量, 丢掉的是最老的 pushEvent 事件, 内部的完成事件不丢, 顺序不变
+// g++ -std=c++20 -O2 -I.. LoopOverflow.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace blxcpp;
+
+// 事件循环卡住的时候另一个线程一直投
+static bool stuckLoop() {
+    const size_t capacity = 64;
+    const int events = 100000;
+    AsyncEventLoop loop(1);
+    loop.setCapacity(capacity, AsyncEventLoop::Overflow::DropOldest);
+
+    std::atomic<bool> stuck(true);
+    std::atomic<size_t> peak(0);
+    std::atomic<int> ran(0);
+    std::atomic<int> oldest(events);
+    loop.pushEvent([&stuck](){
+        while (stuck.load()) std::this_thread::yield();
+    });
+
+    std::thread producer([&](){
+        // 等事件循环进了那个长事件
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        for (int i = 0; i < events; i++) {
+            loop.pushEvent([&ran, &oldest, i](){
+                ran++;
+                if (i < oldest.load()) oldest.store(i);
+            });
+            size_t queued = loop.queued();
+            if (queued > peak.load()) peak.store(queued);
+        }
+        stuck.store(false);
+    });
+
+    loop.epoll();
+    producer.join();
+
+    bool ok = peak.load() <= capacity * 2 && ran.load() == int(capacity) && oldest.load() == events - int(capacity);
+    std::printf("stuck loop: peak %zu ran %d oldest %d dropped %llu: %s\n", peak.load(), ran.load(), oldest.load(),
+                static_cast<unsigned long long>(loop.dropped()), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// 事件循环还没跑, 没人取事件, 全靠投递的线程自己丢
+static bool idleLoop() {
+    const size_t capacity = 4;
+    AsyncEventLoop loop(1);
+    loop.setCapacity(capacity, AsyncEventLoop::Overflow::DropOldest);
+    std::vector<int> order;
+
+    // 最前面是一个 async 的回调, 它是内部事件, 不能丢
+    auto ping = loop.async([](){ });
+    ping([&order](){ order.push_back(-1); });
+    while (loop.queued() < 1) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    // 到两倍容量以后每投一个就丢一个最老的 pushEvent 事件: U0, U1, U2
+    for (int i = 0; i < 10; i++) {
+        loop.pushEvent([&order, i](){ order.push_back(i); });
+    }
+    bool bounded = loop.queued() == capacity * 2;
+
+    // 事件循环取的时候超出容量的继续从最老的丢: U3, U4, U5
+    loop.epoll();
+
+    std::vector<int> want = { -1, 6, 7, 8, 9 };
+    bool ok = bounded && order == want && loop.dropped() == 6;
+    std::printf("idle loop: survivors");
+    for (int id : order) std::printf(" %d", id);
+    std::printf(" dropped %llu: %s\n", static_cast<unsigned long long>(loop.dropped()), ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main() {
+    bool ok = stuckLoop();
+    ok = idleLoop() && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,56 @@
+// tests/LoopShutdown.cpp
+// 还有 accept / read 挂在 io_uring 上的时候停掉事件循环, 析构要能返回, 不能一直等一个不会来的连接
+// g++ -std=c++20 -O2 -I.. LoopShutdown.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "Async.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace blxcpp;
+
+int main() {
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof (addr)) != 0 || listen(listener, 16) != 0) {
+        std::printf("can not listen\n");
+        return 1;
+    }
+    int fds[2];
+    if (pipe(fds) != 0) return 1;
+    static char buf[16];
+
+    std::atomic<int> callbacks(0);
+    bool uring = false;
+    {
+        AsyncEventLoop loop(1);
+        uring = loop.hasIoUring();
+        loop.acceptAsync(listener, [&callbacks](int){ callbacks++; });
+        loop.readAsync(fds[0], buf, sizeof (buf), -1, [&callbacks](int){ callbacks++; });
+
+        // 转几圈让请求真的交给内核, 然后通过 stop 退出
+        int rounds = 0;
+        loop.epoll(1, [&rounds](){ return ++rounds > 10; });
+
+        // 没有 io_uring 的时候请求在线程池里阻塞, 关掉 fd 让它们回来
+        if (!uring) {
+            shutdown(listener, SHUT_RDWR);
+            close(fds[1]);
+            fds[1] = -1;
+        }
+    }
+
+    close(listener);
+    close(fds[0]);
+    if (fds[1] >= 0) close(fds[1]);
+
+    // 走到这里说明析构返回了; 被取消的请求不回调
+    bool ok = !uring || callbacks.load() == 0;
+    std::printf("io_uring %d, callbacks %d: %s\n", int(uring), callbacks.load(), ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,44 @@
+// tests/ParallelOverflow.cpp
+// 队列有容量限制的线程池上跑 parallel_for / parallel_reduce, 不能卡住也不能漏掉或者重复任何一块
+// g++ -std=c++20 -O2 -I.. ParallelOverflow.cpp ../ThreadPool.cpp ../Numa.cpp -lpthread
+#include "Parallel.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+using namespace blxcpp;
+
+static bool check(ThreadPool::Mode mode, ThreadPool::Overflow overflow) {
+    ThreadPool::Options options;
+    options.mode = mode;
+    options.min_threads = 4;
+    options.max_threads = 4;
+    options.capacity = 2;
+    options.overflow = overflow;
+    ThreadPool pool(options);
+
+    const int n = 1 << 16;
+    std::vector<std::atomic<int>> visits(n);
+    for (auto& v : visits) v.store(0);
+    parallel_for(pool, 0, n, 1, [&](int i){ visits[i].fetch_add(1); });
+    for (auto& v : visits) {
+        if (v.load() != 1) return false;
+    }
+
+    long sum = parallel_reduce(pool, range(0, n, 1), 0L,
+                               [](int i){ return long(i); }, [](long a, long b){ return a + b; });
+    return sum == long(n) * (n - 1) / 2;
+}
+
+int main() {
+    int failed = 0;
+    for (auto mode : { ThreadPool::Mode::Shared, ThreadPool::Mode::WorkStealing }) {
+        for (auto overflow : { ThreadPool::Overflow::Block, ThreadPool::Overflow::Reject, ThreadPool::Overflow::DropOldest }) {
+            bool ok = check(mode, overflow);
+            std::printf("mode %d overflow %d: %s\n", int(mode), int(overflow), ok ? "ok" : "FAILED");
+            if (!ok) failed++;
+        }
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,45 @@
+// tests/RuntimePost.cpp
+// AsyncRuntime::post 只移动不拷贝: 外部线程和分片之间互相 post 只能移动的消息, 环形队列满了也一个不丢
+// g++ -std=c++20 -O1 -g -fsanitize=thread -I.. RuntimePost.cpp ../AsyncRuntime.cpp ../Async.cpp ../Timer.cpp ../Clock.cpp ../ThreadPool.cpp ../IoUring.cpp ../Numa.cpp -lpthread
+#include "AsyncRuntime.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+using namespace blxcpp;
+
+int main() {
+    const int messages = 20000;
+    AsyncRuntime::Options options;
+    options.shards = 4;
+    options.ring_capacity = 16; // 故意开小, 让一部分消息走 pushEvent
+    options.pin = false;
+    AsyncRuntime runtime(options);
+    std::atomic<long> sum(0);
+    std::atomic<int> received(0);
+
+    // 每条消息先从外部线程发到一个分片, 再由那个分片转发给下一个分片
+    for (int i = 0; i < messages; i++) {
+        std::unique_ptr<int> value(new int(i));
+        runtime.post([&runtime, &sum, &received, value = std::move(value)]() mutable {
+            size_t to = (runtime.currentShard() + 1) % runtime.size();
+            runtime.post(to, [&sum, &received, value = std::move(value)](){
+                sum += *value;
+                received++;
+            });
+        });
+    }
+
+    for (int i = 0; i < 1000 && received.load() < messages; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    runtime.stop();
+
+    long want = long(messages) * (messages - 1) / 2;
+    bool ok = received.load() == messages && sum.load() == want;
+    std::printf("received %d sum %ld (want %ld): %s\n", received.load(), sum.load(), want, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,58 @@
+// tests/SharedAlloc.cpp
+// Shared 模式下从外面投的小任务, 各条 lane 的环形队列攒够容量以后不应该再碰分配器
+// g++ -std=c++20 -O2 -I.. SharedAlloc.cpp ../ThreadPool.cpp ../Numa.cpp -lpthread
+#include "ThreadPool.hpp"
+#include "Latch.hpp"
+#include "AllocCounter.hpp"
+
+#include <atomic>
+#include <cstdio>
+
+using namespace blxcpp;
+
+int main() {
+    const int tasks = 10000;
+    ThreadPool pool(2);
+    std::atomic<long> done(0);
+
+    // 三条 lane 轮流投, 捕获的东西放得进 UniqueTask 的内联缓冲
+    auto submit = [&pool, &done, tasks](){
+        for (int i = 0; i < tasks; i++) {
+            long a = i, b = i;
+            auto task = [&done, a, b](){ if (a == b) done.fetch_add(1, std::memory_order_relaxed); };
+            switch (i % 3) {
+            case 0: pool.put(task, ThreadPool::Priority::High); break;
+            case 1: pool.put(task); break;
+            case 2: pool.put(task, ThreadPool::Priority::Low); break;
+            }
+        }
+    };
+    auto round = [&pool, &submit](){
+        submit();
+        pool.wait_idle();
+    };
+
+    // 热身: 先把两个 worker 都卡住再投一整轮, 每条 lane 都要装下这一轮全部的任务, 环形队列只涨不缩
+    Latch started(2);
+    Latch release(1);
+    for (int w = 0; w < 2; w++) {
+        pool.put([&started, &release](){
+            started.count_down();
+            release.wait();
+        });
+    }
+    started.wait();
+    submit();
+    release.count_down();
+    pool.wait_idle();
+
+    const int rounds = 20;
+    done = 0;
+    long before = allocations.load();
+    for (int i = 0; i < rounds; i++) round();
+    long used = allocations.load() - before;
+
+    bool ok = done.load() == long(tasks) * rounds && used == 0;
+    std::printf("%d shared tasks, %ld allocations: %s\n", tasks * rounds, used, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
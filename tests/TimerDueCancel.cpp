@@ -0,0 +1,76 @@
+// tests/TimerDueCancel.cpp
+// 别的线程的 clear 走的是 id 所在分片的命令队列, 到 tick 的时候 timer 可能已经到期了
+// 约定是 tick 先应用命令: 在 tick 之前推进去的 clear 一律按取消算, 已经触发过的再 clear 什么都不做
+// 每一步都等取消的线程 join 完再 tick, 结果是确定的
+// g++ -std=c++20 -O2 -I.. TimerDueCancel.cpp ../Timer.cpp ../Clock.cpp -lpthread
+#include "Timer.hpp"
+
+#include <cstdio>
+#include <thread>
+
+using namespace blxcpp;
+
+// 在另一个线程上 clear, 这个线程的分片和 id 所在的分片不是同一个
+static void clearFromOtherThread(Timer::Ref ref) {
+    std::thread canceller([ref]() mutable { ref.clear(); });
+    canceller.join();
+}
+
+int main() {
+    bool ok = true;
+
+    // 已经应用了, 时间也推过了到期时间, clear 还在队列里: 不触发
+    {
+        Timer timer(0);
+        int fired = 0;
+        Timer::Ref ref = timer.setTimeout(5000, false, [&fired](){ fired++; });
+        timer.tick(1000); // 到期时间从应用命令的这次 tick 开始算
+        clearFromOtherThread(ref);
+        timer.tick(100000);
+        bool pass = fired == 0 && timer.empty();
+        std::printf("due then cancelled: fired %d: %s\n", fired, pass ? "ok" : "FAILED");
+        ok = ok && pass;
+    }
+
+    // set 和 clear 都还没应用, 而且下一次 tick 的时候已经到期: 不触发
+    {
+        Timer timer(0);
+        int fired = 0;
+        Timer::Ref ref = timer.setTimeout(0, false, [&fired](){ fired++; });
+        clearFromOtherThread(ref);
+        timer.tick(100000);
+        bool pass = fired == 0 && timer.empty();
+        std::printf("set and cancel in one tick: fired %d: %s\n", fired, pass ? "ok" : "FAILED");
+        ok = ok && pass;
+    }
+
+    // 已经触发过了再 clear: 什么都不做, 也不会再触发
+    {
+        Timer timer(0);
+        int fired = 0;
+        Timer::Ref ref = timer.setTimeout(5000, false, [&fired](){ fired++; });
+        timer.tick(0);
+        timer.tick(10000);
+        clearFromOtherThread(ref);
+        timer.tick(20000);
+        bool pass = fired == 1 && timer.empty();
+        std::printf("fired then cancelled: fired %d: %s\n", fired, pass ? "ok" : "FAILED");
+        ok = ok && pass;
+    }
+
+    // 重复的 timer 触发过一次, 下一次也已经到期了: 从下一次 tick 开始不再触发
+    {
+        Timer timer(0);
+        int fired = 0;
+        Timer::Ref ref = timer.setTimeout(5000, true, [&fired](){ fired++; });
+        timer.tick(0);
+        timer.tick(5000);
+        clearFromOtherThread(ref);
+        timer.tick(100000);
+        bool pass = fired == 1 && timer.empty();
+        std::printf("repeat then cancelled: fired %d: %s\n", fired, pass ? "ok" : "FAILED");
+        ok = ok && pass;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,78 @@
+// tests/TimerStress.cpp
+// 多个线程同时 setTimeout / clear, 一个线程 tick; 取消掉的不能触发, 没取消的一个都不能少
+// 有一半的取消交给另一个线程做, 这些 timer 和 tick 赛跑, 可能先到期, 只要求每个最多触发一次
+// 到期时刻的取消具体怎么算见 TimerDueCancel.cpp, 用 -fsanitize=thread 编译跑, 参数是每个线程的操作数
+// g++ -std=c++20 -O1 -g -fsanitize=thread -I.. TimerStress.cpp ../Timer.cpp ../Clock.cpp -lpthread
+#include "Timer.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace blxcpp;
+
+int main(int argc, char** argv) {
+    const int threads = 8;
+    const int per_thread = argc > 1 ? std::atoi(argv[1]) : 125000;
+    const int batch = 1000;
+
+    Timer timer(0);
+    std::atomic<long> fired(0);
+    std::atomic<long> bad(0);
+    std::atomic<long> raced(0); // 交给别的线程取消, 但是 clear 应用之前已经触发了的
+    std::atomic<bool> done(false);
+
+    std::thread ticker([&timer, &done](){
+        Timer::Time now = 0;
+        while (!done.load() || !timer.empty()) timer.tick(now += 1000);
+    });
+
+    std::vector<std::thread> workers;
+    for (int w = 0; w < threads; w++) {
+        workers.emplace_back([&timer, &fired, &bad, &raced, per_thread, batch](){
+            std::vector<Timer::Ref> handoff;
+            for (int i = 0; i < per_thread; i++) {
+                switch (i % 4) {
+                case 0:
+                case 1:
+                    timer.setTimeout(5000, false, [&fired](){ fired++; });
+                    break;
+                case 2:
+                    // 同一个线程的 set 和 clear 在同一个分片里按顺序应用, 不管多短都不会触发
+                    timer.setTimeout(5000, false, [&bad](){ bad++; }).clear();
+                    break;
+                case 3:
+                    handoff.push_back(timer.setTimeout(5000, false, [&raced](){ raced++; }));
+                    break;
+                }
+                // 攒够一批交给别的线程取消
+                if (handoff.size() == batch || i + 1 == per_thread) {
+                    std::thread canceller([refs = std::move(handoff)]() mutable {
+                        for (auto& ref : refs) ref.clear();
+                    });
+                    canceller.join();
+                    handoff.clear();
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    done = true;
+    ticker.join();
+
+    long want = 0;
+    long handed = 0;
+    for (int i = 0; i < per_thread; i++) {
+        if (i % 4 < 2) want++;
+        if (i % 4 == 3) handed++;
+    }
+    want *= threads;
+    handed *= threads;
+
+    bool ok = fired.load() == want && bad.load() == 0 && raced.load() <= handed;
+    std::printf("%ld arm/cancel, fired %ld (want %ld), fired after cancel %ld, beat cross-thread cancel %ld/%ld: %s\n",
+                (long)threads * per_thread * 3 / 2, fired.load(), want, bad.load(), raced.load(), handed, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}